@@ -0,0 +1,65 @@
+#include <atom.h>
+#include <benchmark/benchmark.h>
+#include <env.h>
+#include <eval.h>
+#include <gc.h>
+#include <read.h>
+#include <source.h>
+
+// Evaluates a small arithmetic expression over and over, collecting as the REPL would. Build with
+// and without -DNAN_BOXING=ON to compare the value representations.
+static void BM_Arithmetic(benchmark::State &state, const char *code) {
+  struct source_file *source = source_file_str(code, 0);
+  struct atom *expr = read_atom(source);
+  struct environment *env = create_default_environment();
+  gc_retain(expr);
+  gc_retain(env);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(eval(expr, env));
+    gc_maybe_run();
+  }
+
+  gc_release(env);
+  gc_release(expr);
+  gc_run();
+
+  source_file_free(source);
+}
+BENCHMARK_CAPTURE(BM_Arithmetic, int, "(+ (* 3 4) (- 10 2) (/ 9 3) 1)");
+BENCHMARK_CAPTURE(BM_Arithmetic, float, "(+ (* 3.5 4.0) (- 10.5 2.25) (/ 9.0 3.0) 1.0)");
+
+// Sums 4096 floats held in a list (through apply and the arithmetic primitives) and in an unboxed
+// array (through the SIMD kernels).
+static void BM_Sum(benchmark::State &state, const char *setup, const char *code) {
+  struct environment *env = create_default_environment();
+  gc_retain(env);
+
+  struct source_file *source = source_file_str(setup, 0);
+  while (!source_file_eof(source)) {
+    eval(read_atom(source), env);
+  }
+  source_file_free(source);
+
+  source = source_file_str(code, 0);
+  struct atom *expr = read_atom(source);
+  gc_retain(expr);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(eval(expr, env));
+    gc_maybe_run();
+  }
+  state.SetItemsProcessed(state.iterations() * 4096);
+
+  gc_release(expr);
+  gc_release(env);
+  gc_run();
+
+  source_file_free(source);
+}
+
+static const char *kSumSetup =
+    "(define fill (lambda (n acc) (cond ((eq? n 0) acc) (t (fill (- n 1) (cons 1.5 acc))))))"
+    "(define xs (fill 4096 nil))";
+BENCHMARK_CAPTURE(BM_Sum, list, kSumSetup, "(apply + xs)");
+BENCHMARK_CAPTURE(BM_Sum, array, "(define xs (make-array :float 4096))", "(array-sum xs)");
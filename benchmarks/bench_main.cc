@@ -0,0 +1,31 @@
+#include <benchmark/benchmark.h>
+#include <clog.h>
+#include <env.h>
+#include <gc.h>
+#include <intern.h>
+#include <log.h>
+#include <special.h>
+
+int main(int argc, char **argv) {
+  ::benchmark::Initialize(&argc, argv);
+  if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+
+  logging_init(0, CLOG_WARN);
+  gc_init();
+
+  init_intern_tables();
+
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+
+  cleanup_special_forms();
+  env_reset_shadows();
+  cleanup_intern_tables();
+
+  gc_run();
+  gc_shutdown();
+  logging_shutdown();
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include <atom.h>
+#include <benchmark/benchmark.h>
+#include <env.h>
+#include <eval.h>
+#include <gc.h>
+#include <read.h>
+#include <source.h>
+
+// Runs a tail-recursive loop that does little but read its parameters and let variables, which
+// the resolver turns into slot references.
+static void BM_VariableAccess(benchmark::State &state, const char *setup, const char *code) {
+  struct environment *env = create_default_environment();
+  gc_retain(env);
+
+  struct source_file *source = source_file_str(setup, 0);
+  while (!source_file_eof(source)) {
+    eval(read_atom(source), env);
+  }
+  source_file_free(source);
+
+  source = source_file_str(code, 0);
+  struct atom *expr = read_atom(source);
+  gc_retain(expr);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(eval(expr, env));
+    gc_maybe_run();
+  }
+  state.SetItemsProcessed(state.iterations() * 1000);
+
+  gc_release(expr);
+  gc_release(env);
+  gc_run();
+
+  source_file_free(source);
+}
+BENCHMARK_CAPTURE(BM_VariableAccess, params,
+                  "(defun count (n acc) (cond ((eq? n 0) acc) (t (count (- n 1) (+ acc n)))))",
+                  "(count 1000 0)");
+BENCHMARK_CAPTURE(BM_VariableAccess, let,
+                  "(defun count (n acc)"
+                  "  (cond ((eq? n 0) acc) (t (let ((a n) (b acc)) (count (- a 1) (+ b a))))))",
+                  "(count 1000 0)");
+BENCHMARK_CAPTURE(BM_VariableAccess, closure,
+                  "(define count nil)"
+                  "(defun make-counter (step)"
+                  "  (lambda (n acc) (cond ((eq? n 0) acc) (t (count (- n step) (+ acc n))))))"
+                  "(set! count (make-counter 1))",
+                  "(count 1000 0)");
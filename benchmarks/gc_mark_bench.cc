@@ -0,0 +1,43 @@
+#include <atom.h>
+#include <benchmark/benchmark.h>
+#include <gc.h>
+
+// Builds a balanced tree of cells cons cells, which gives parallel markers plenty of branches to
+// steal.
+static struct atom *build_tree(int64_t cells) {
+  if (cells == 0) {
+    return atom_nil();
+  }
+
+  int64_t left = (cells - 1) / 2;
+  struct atom *car = build_tree(left);
+  struct atom *cdr = build_tree(cells - 1 - left);
+  return new_cons(car, cdr);
+}
+
+// Full collections of a heap where everything is live, so nearly all the time is spent marking.
+static void BM_MarkHeap(benchmark::State &state) {
+  struct atom *heap = build_tree(state.range(0));
+  gc_retain(heap);
+
+  // Promote the whole tree first, so each iteration measures marking a settled heap.
+  gc_run();
+
+  gc_set_threads((int)state.range(1));
+
+  for (auto _ : state) {
+    gc_run();
+  }
+
+  gc_set_threads(1);
+
+  gc_release(heap);
+  gc_run();
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MarkHeap)
+    ->ArgNames({"cells", "threads"})
+    ->ArgsProduct({{1 << 20, 10 * 1000 * 1000}, {1, 2, 4, 8, 16, 32}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
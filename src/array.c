@@ -0,0 +1,273 @@
+#include "array.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+// The kernels below work on four elements at a time using GCC vector extensions, which compile to
+// SSE2 on any x86-64 and to the native SIMD instructions elsewhere, with a scalar loop for the
+// remaining elements. On x86-64 each kernel is also built for AVX2 and the best version for the
+// CPU is picked when the program is loaded.
+#if defined(__x86_64__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define ARRAY_KERNEL __attribute__((target_clones("avx2", "default")))
+#endif
+#endif
+
+#ifndef ARRAY_KERNEL
+#define ARRAY_KERNEL
+#endif
+
+#define ARRAY_LANES 4
+
+// Only 8-byte aligned, so they can load from and store to any element of a malloc'd array.
+typedef double f64xN __attribute__((vector_size(ARRAY_LANES * sizeof(double)), aligned(8)));
+typedef int64_t i64xN __attribute__((vector_size(ARRAY_LANES * sizeof(int64_t)), aligned(8)));
+// Integers are added and multiplied unsigned, so that overflow wraps rather than being undefined.
+typedef uint64_t u64xN __attribute__((vector_size(ARRAY_LANES * sizeof(uint64_t)), aligned(8)));
+
+#define ARRAY_BINARY_KERNEL(name, type, vtype, op)                                  \
+  ARRAY_KERNEL static void name(type *out, const type *a, const type *b, size_t n) { \
+    size_t i = 0;                                                                   \
+    for (; i + ARRAY_LANES <= n; i += ARRAY_LANES) {                                \
+      *(vtype *)(out + i) = *(const vtype *)(a + i) op * (const vtype *)(b + i);    \
+    }                                                                               \
+    for (; i < n; ++i) {                                                            \
+      out[i] = a[i] op b[i];                                                        \
+    }                                                                               \
+  }
+
+ARRAY_BINARY_KERNEL(f64_add, double, f64xN, +)
+ARRAY_BINARY_KERNEL(f64_mul, double, f64xN, *)
+ARRAY_BINARY_KERNEL(u64_add, uint64_t, u64xN, +)
+ARRAY_BINARY_KERNEL(u64_mul, uint64_t, u64xN, *)
+
+// Reductions keep a partial sum per lane and add the lanes together at the end.
+#define ARRAY_SUM_KERNEL(name, type, vtype)                      \
+  ARRAY_KERNEL static type name(const type *a, size_t n) {       \
+    vtype acc = {0};                                             \
+    size_t i = 0;                                                \
+    for (; i + ARRAY_LANES <= n; i += ARRAY_LANES) {             \
+      acc += *(const vtype *)(a + i);                            \
+    }                                                            \
+                                                                 \
+    type result = 0;                                             \
+    for (size_t lane = 0; lane < ARRAY_LANES; ++lane) {          \
+      result += acc[lane];                                       \
+    }                                                            \
+    for (; i < n; ++i) {                                         \
+      result += a[i];                                            \
+    }                                                            \
+    return result;                                               \
+  }
+
+#define ARRAY_DOT_KERNEL(name, type, vtype)                                    \
+  ARRAY_KERNEL static type name(const type *a, const type *b, size_t n) {      \
+    vtype acc = {0};                                                           \
+    size_t i = 0;                                                              \
+    for (; i + ARRAY_LANES <= n; i += ARRAY_LANES) {                           \
+      acc += *(const vtype *)(a + i) * *(const vtype *)(b + i);                \
+    }                                                                          \
+                                                                               \
+    type result = 0;                                                           \
+    for (size_t lane = 0; lane < ARRAY_LANES; ++lane) {                        \
+      result += acc[lane];                                                     \
+    }                                                                          \
+    for (; i < n; ++i) {                                                       \
+      result += a[i] * b[i];                                                   \
+    }                                                                          \
+    return result;                                                             \
+  }
+
+ARRAY_SUM_KERNEL(f64_sum, double, f64xN)
+ARRAY_SUM_KERNEL(u64_sum, uint64_t, u64xN)
+ARRAY_DOT_KERNEL(f64_dot, double, f64xN)
+ARRAY_DOT_KERNEL(u64_dot, uint64_t, u64xN)
+
+// Returns the smallest (cmp is <) or largest (cmp is >) of n > 0 elements. Vector comparisons
+// give a mask of all-ones lanes where they hold, used to pick between the two vectors bitwise.
+#define ARRAY_EXTREME_KERNEL(name, type, vtype, cmp)                                  \
+  ARRAY_KERNEL static type name(const type *a, size_t n) {                            \
+    size_t i = 0;                                                                     \
+    type result = a[0];                                                               \
+    if (n >= ARRAY_LANES) {                                                           \
+      vtype acc = *(const vtype *)a;                                                  \
+      for (i = ARRAY_LANES; i + ARRAY_LANES <= n; i += ARRAY_LANES) {                 \
+        vtype v = *(const vtype *)(a + i);                                            \
+        i64xN mask = v cmp acc;                                                       \
+        acc = (vtype)(((i64xN)v & mask) | ((i64xN)acc & ~mask));                      \
+      }                                                                               \
+      result = acc[0];                                                                \
+      for (size_t lane = 1; lane < ARRAY_LANES; ++lane) {                             \
+        result = acc[lane] cmp result ? acc[lane] : result;                           \
+      }                                                                               \
+    }                                                                                 \
+    for (; i < n; ++i) {                                                              \
+      result = a[i] cmp result ? a[i] : result;                                       \
+    }                                                                                 \
+    return result;                                                                    \
+  }
+
+ARRAY_EXTREME_KERNEL(f64_min, double, f64xN, <)
+ARRAY_EXTREME_KERNEL(f64_max, double, f64xN, >)
+ARRAY_EXTREME_KERNEL(i64_min, int64_t, i64xN, <)
+ARRAY_EXTREME_KERNEL(i64_max, int64_t, i64xN, >)
+
+struct atom *new_array(enum AtomType element_type, size_t len) {
+  // both element types are 8 bytes
+  int64_t *data = NULL;
+  if (len) {
+    data = len <= SIZE_MAX / sizeof(int64_t) ? calloc(len, sizeof(int64_t)) : NULL;
+    if (!data) {
+      return new_atom_error(NULL, "can't allocate an array of %zu elements", len);
+    }
+  }
+
+  struct atom *atom = gc_new(GC_TYPE_ATOM, sizeof(struct atom));
+  atom->type = ATOM_TYPE_ARRAY;
+  atom->value.array.element_type = element_type;
+  atom->value.array.len = len;
+  atom->value.array.data.ints = data;
+  gc_note_external(len * sizeof(int64_t));
+  return atom;
+}
+
+struct atom *array_ref(struct atom *array, size_t index) {
+  if (array->value.array.element_type == ATOM_TYPE_FLOAT) {
+    return new_float(array->value.array.data.floats[index]);
+  }
+
+  return new_int(array->value.array.data.ints[index]);
+}
+
+struct atom *array_set(struct atom *array, size_t index, struct atom *value) {
+  enum AtomType element_type = array->value.array.element_type;
+  if (atom_type_of(value) != element_type) {
+    return new_atom_error(value, "array elements must be of type %s, got %s",
+                          atom_type_to_string(element_type),
+                          atom_type_to_string(atom_type_of(value)));
+  }
+
+  if (element_type == ATOM_TYPE_FLOAT) {
+    array->value.array.data.floats[index] = atom_float(value);
+  } else {
+    array->value.array.data.ints[index] = atom_int(value);
+  }
+
+  return value;
+}
+
+// Returns an error if the two arrays can't be combined elementwise, NULL otherwise.
+static struct atom *array_check_pair(struct atom *a, struct atom *b) {
+  if (a->value.array.element_type != b->value.array.element_type) {
+    return new_atom_error(b, "array element types differ: %s and %s",
+                          atom_type_to_string(a->value.array.element_type),
+                          atom_type_to_string(b->value.array.element_type));
+  }
+
+  if (a->value.array.len != b->value.array.len) {
+    return new_atom_error(b, "array lengths differ: %zu and %zu", a->value.array.len,
+                          b->value.array.len);
+  }
+
+  return NULL;
+}
+
+struct atom *array_add(struct atom *a, struct atom *b) {
+  struct atom *error = array_check_pair(a, b);
+  if (error) {
+    return error;
+  }
+
+  struct atom *result = new_array(a->value.array.element_type, a->value.array.len);
+  if (is_error(result)) {
+    return result;
+  }
+
+  if (a->value.array.element_type == ATOM_TYPE_FLOAT) {
+    f64_add(result->value.array.data.floats, a->value.array.data.floats,
+            b->value.array.data.floats, a->value.array.len);
+  } else {
+    u64_add((uint64_t *)result->value.array.data.ints, (const uint64_t *)a->value.array.data.ints,
+            (const uint64_t *)b->value.array.data.ints, a->value.array.len);
+  }
+
+  return result;
+}
+
+struct atom *array_mul(struct atom *a, struct atom *b) {
+  struct atom *error = array_check_pair(a, b);
+  if (error) {
+    return error;
+  }
+
+  struct atom *result = new_array(a->value.array.element_type, a->value.array.len);
+  if (is_error(result)) {
+    return result;
+  }
+
+  if (a->value.array.element_type == ATOM_TYPE_FLOAT) {
+    f64_mul(result->value.array.data.floats, a->value.array.data.floats,
+            b->value.array.data.floats, a->value.array.len);
+  } else {
+    u64_mul((uint64_t *)result->value.array.data.ints, (const uint64_t *)a->value.array.data.ints,
+            (const uint64_t *)b->value.array.data.ints, a->value.array.len);
+  }
+
+  return result;
+}
+
+struct atom *array_sum(struct atom *array) {
+  if (array->value.array.element_type == ATOM_TYPE_FLOAT) {
+    return new_float(f64_sum(array->value.array.data.floats, array->value.array.len));
+  }
+
+  return new_int(
+      (int64_t)u64_sum((const uint64_t *)array->value.array.data.ints, array->value.array.len));
+}
+
+struct atom *array_dot(struct atom *a, struct atom *b) {
+  struct atom *error = array_check_pair(a, b);
+  if (error) {
+    return error;
+  }
+
+  if (a->value.array.element_type == ATOM_TYPE_FLOAT) {
+    return new_float(
+        f64_dot(a->value.array.data.floats, b->value.array.data.floats, a->value.array.len));
+  }
+
+  return new_int((int64_t)u64_dot((const uint64_t *)a->value.array.data.ints,
+                                  (const uint64_t *)b->value.array.data.ints, a->value.array.len));
+}
+
+struct atom *array_min(struct atom *array) {
+  if (!array->value.array.len) {
+    return new_atom_error(array, "minimum of an empty array");
+  }
+
+  if (array->value.array.element_type == ATOM_TYPE_FLOAT) {
+    return new_float(f64_min(array->value.array.data.floats, array->value.array.len));
+  }
+
+  return new_int(i64_min(array->value.array.data.ints, array->value.array.len));
+}
+
+struct atom *array_max(struct atom *array) {
+  if (!array->value.array.len) {
+    return new_atom_error(array, "maximum of an empty array");
+  }
+
+  if (array->value.array.element_type == ATOM_TYPE_FLOAT) {
+    return new_float(f64_max(array->value.array.data.floats, array->value.array.len));
+  }
+
+  return new_int(i64_max(array->value.array.data.ints, array->value.array.len));
+}
+
+void array_gc_erase(struct atom *array) {
+  free(array->value.array.data.ints);
+  array->value.array.data.ints = NULL;
+  gc_forget_external(array->value.array.len * sizeof(int64_t));
+}
@@ -0,0 +1,42 @@
+#ifndef _QUANTA_ARRAY_H
+#define _QUANTA_ARRAY_H
+
+#include <stddef.h>
+
+#include "atom.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns a zero-filled array of len elements of the given type, ATOM_TYPE_INT (int64_t) or
+// ATOM_TYPE_FLOAT (double), or an error if there isn't the memory for that many.
+struct atom *new_array(enum AtomType element_type, size_t len);
+
+// Returns the element at index as an integer or float atom. The index must be in bounds.
+struct atom *array_ref(struct atom *array, size_t index);
+// Stores a number at index, returning an error if it isn't of the array's element type. The index
+// must be in bounds.
+struct atom *array_set(struct atom *array, size_t index, struct atom *value);
+
+// Elementwise addition and multiplication, returning a new array or an error if the arrays'
+// element types or lengths differ. Integer arithmetic wraps around on overflow.
+struct atom *array_add(struct atom *a, struct atom *b);
+struct atom *array_mul(struct atom *a, struct atom *b);
+
+// Reductions, returning a number of the array's element type. Floats are summed in several lanes
+// at once, so the result may differ from a left-to-right sum by rounding. array_dot returns an
+// error if the arrays don't match, and array_min/array_max if the array is empty.
+struct atom *array_sum(struct atom *array);
+struct atom *array_dot(struct atom *a, struct atom *b);
+struct atom *array_min(struct atom *array);
+struct atom *array_max(struct atom *array);
+
+// Frees the array's elements.
+void array_gc_erase(struct atom *array);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // _QUANTA_ARRAY_H
@@ -1,11 +1,19 @@
 #include "atom.h"
 
 #include <glib.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "array.h"
+#include "bignum.h"
 #include "env.h"
 #include "gc.h"
+#include "table.h"
+
+// Longest run of cdr links atom_mark_children follows before queueing the rest of the list.
+#define ATOM_MARK_CDR_LIMIT 4096
 
 static struct atom g_atom_nil = {
     .type = ATOM_TYPE_NIL,
@@ -41,6 +49,142 @@ struct atom *new_atom(enum AtomType type, union atom_value value) {
   return atom;
 }
 
+struct string_buffer {
+  size_t refs;
+  size_t size;  // of data, as charged to the GC budgets
+  char data[];
+};
+
+static struct string_buffer *string_buffer_of(char *ptr) {
+  return (struct string_buffer *)(ptr - offsetof(struct string_buffer, data));
+}
+
+char *string_buffer_new(size_t size) {
+  struct string_buffer *buffer = malloc(sizeof(struct string_buffer) + size);
+  buffer->refs = 1;
+  buffer->size = size;
+  gc_note_external(size);
+  return buffer->data;
+}
+
+char *string_buffer_resize(char *ptr, size_t size) {
+  struct string_buffer *buffer =
+      realloc(string_buffer_of(ptr), sizeof(struct string_buffer) + size);
+  if (size > buffer->size) {
+    gc_note_external(size - buffer->size);
+  } else {
+    gc_forget_external(buffer->size - size);
+  }
+  buffer->size = size;
+  return buffer->data;
+}
+
+void string_buffer_free(char *ptr) {
+  struct string_buffer *buffer = string_buffer_of(ptr);
+  gc_forget_external(buffer->size);
+  free(buffer);
+}
+
+struct atom *new_string(enum AtomType type, const char *ptr, size_t len) {
+  if (len >= ATOM_STRING_INLINE) {
+    char *data = string_buffer_new(len + 1);
+    memcpy(data, ptr, len);
+    return new_string_owned(type, data, len);
+  }
+
+  struct atom *atom = gc_new(GC_TYPE_ATOM, sizeof(struct atom));
+  atom->type = type;
+  atom->value.string.ptr = atom->value.string.storage.small;
+  atom->value.string.len = len;
+  memcpy(atom->value.string.ptr, ptr, len);
+  atom->value.string.ptr[len] = '\0';
+  return atom;
+}
+
+struct atom *new_string_owned(enum AtomType type, char *ptr, size_t len) {
+  if (len < ATOM_STRING_INLINE) {
+    struct atom *atom = new_string(type, ptr, len);
+    string_buffer_free(ptr);
+    return atom;
+  }
+
+  ptr[len] = '\0';
+
+  struct atom *atom = gc_new(GC_TYPE_ATOM, sizeof(struct atom));
+  atom->type = type;
+  atom->value.string.ptr = ptr;
+  atom->value.string.len = len;
+  atom->value.string.storage.buffer = string_buffer_of(ptr);
+  return atom;
+}
+
+struct atom *new_substring(struct atom *string, size_t start, size_t len) {
+  if (len < ATOM_STRING_INLINE) {
+    return new_string(ATOM_TYPE_STRING, string->value.string.ptr + start, len);
+  }
+
+  // only strings too long to be inline have a buffer, and this one is at least as long
+  struct string_buffer *buffer = string->value.string.storage.buffer;
+  ++buffer->refs;
+
+  struct atom *atom = gc_new(GC_TYPE_ATOM, sizeof(struct atom));
+  atom->type = ATOM_TYPE_STRING;
+  atom->value.string.ptr = string->value.string.ptr + start;
+  atom->value.string.len = len;
+  atom->value.string.storage.buffer = buffer;
+  return atom;
+}
+
+struct atom *new_symbol(enum AtomType type, const char *name, size_t len) {
+  struct atom *atom = gc_new(GC_TYPE_SYMBOL, sizeof(struct atom));
+  atom->type = type;
+  atom->value.string.len = len;
+  if (len >= ATOM_STRING_INLINE) {
+    atom->value.string.ptr = string_buffer_new(len + 1);
+    atom->value.string.storage.buffer = string_buffer_of(atom->value.string.ptr);
+  } else {
+    atom->value.string.ptr = atom->value.string.storage.small;
+  }
+  memcpy(atom->value.string.ptr, name, len);
+  atom->value.string.ptr[len] = '\0';
+  return atom;
+}
+
+char *atom_string_dup(struct atom *string) {
+  char *copy = malloc(string->value.string.len + 1);
+  memcpy(copy, string->value.string.ptr, string->value.string.len);
+  copy[string->value.string.len] = '\0';
+  return copy;
+}
+
+struct atom *new_int(int64_t value) {
+  if (value < ATOM_FIXNUM_MIN || value > ATOM_FIXNUM_MAX) {
+    union atom_value boxed = {.ivalue = value};
+    return new_atom(ATOM_TYPE_INT, boxed);
+  }
+
+#ifdef QUANTA_NAN_BOXING
+  return (struct atom *)(uintptr_t)(((uint64_t)value & ~ATOM_NAN_TAG_MASK) | ATOM_FIXNUM_TAG);
+#else
+  return (struct atom *)(((uintptr_t)value << 1) | ATOM_FIXNUM_TAG);
+#endif
+}
+
+struct atom *new_float(double value) {
+#ifdef QUANTA_NAN_BOXING
+  if (isnan(value)) {
+    value = NAN;
+  }
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return (struct atom *)(uintptr_t)(bits + ATOM_DOUBLE_OFFSET);
+#else
+  union atom_value boxed = {.fvalue = value};
+  return new_atom(ATOM_TYPE_FLOAT, boxed);
+#endif
+}
+
 struct atom *new_cons(struct atom *car, struct atom *cdr) {
   // (nil . nil) is perfectly legal. Here we simply check for invaid internal usage.
   if (car == NULL && cdr == NULL) {
@@ -54,9 +198,84 @@ struct atom *new_cons(struct atom *car, struct atom *cdr) {
     cdr = atom_nil();
   }
 
-  union atom_value value = {.cons = {.car = car, .cdr = cdr}};
+  struct cons *cons = gc_new(GC_TYPE_CONS, sizeof(struct cons));
+  cons->car = car;
+  cons->cdr = cdr;
+  return (struct atom *)cons;
+}
 
-  return new_atom(ATOM_TYPE_CONS, value);
+struct atom *new_list(struct atom **items, size_t count, struct atom *tail) {
+  if (!tail) {
+    tail = atom_nil();
+  }
+
+  struct cons *head = NULL;
+  struct cons *prev = NULL;
+
+  for (size_t i = 0; i < count; ++i) {
+    struct cons *cons = gc_new(GC_TYPE_CONS, sizeof(struct cons));
+    cons->car = items ? items[i] : atom_nil();
+    cons->cdr = tail;
+
+    if (prev) {
+      prev->cdr = (struct atom *)cons;
+      gc_write_barrier(prev);
+    } else {
+      head = cons;
+    }
+
+    prev = cons;
+  }
+
+  return head ? (struct atom *)head : tail;
+}
+
+struct atom *new_vector(size_t len, struct atom *fill) {
+  if (!fill) {
+    fill = atom_nil();
+  }
+
+  struct atom **items = NULL;
+  if (len) {
+    items = len <= SIZE_MAX / sizeof(struct atom *) ? malloc(len * sizeof(struct atom *)) : NULL;
+    if (!items) {
+      return new_atom_error(NULL, "can't allocate a vector of %zu elements", len);
+    }
+  }
+
+  struct atom *atom = gc_new(GC_TYPE_ATOM, sizeof(struct atom));
+  atom->type = ATOM_TYPE_VECTOR;
+  atom->value.vector.items = items;
+  atom->value.vector.len = len;
+  atom->value.vector.cap = len;
+  gc_note_external(len * sizeof(struct atom *));
+
+  for (size_t i = 0; i < len; ++i) {
+    atom->value.vector.items[i] = fill;
+  }
+
+  return atom;
+}
+
+struct atom *vector_push(struct atom *vector, struct atom *item) {
+  if (vector->value.vector.len == vector->value.vector.cap) {
+    size_t cap = vector->value.vector.cap ? vector->value.vector.cap * 2 : 8;
+    struct atom **items = cap <= SIZE_MAX / sizeof(struct atom *)
+                              ? realloc(vector->value.vector.items, cap * sizeof(struct atom *))
+                              : NULL;
+    if (!items) {
+      return new_atom_error(vector, "can't grow a vector of %zu elements",
+                            vector->value.vector.len);
+    }
+
+    vector->value.vector.items = items;
+    gc_note_external((cap - vector->value.vector.cap) * sizeof(struct atom *));
+    vector->value.vector.cap = cap;
+  }
+
+  vector->value.vector.items[vector->value.vector.len++] = item;
+  gc_write_barrier(vector);
+  return vector;
 }
 
 void erase_atom(struct atom *atom) {
@@ -68,11 +287,28 @@ void erase_atom(struct atom *atom) {
     case ATOM_TYPE_STRING:
     case ATOM_TYPE_SYMBOL:
     case ATOM_TYPE_KEYWORD:
-      free(atom->value.string.ptr);
+      // buffers are shared with substrings, and freed along with the last string using them
+      if (atom->value.string.len >= ATOM_STRING_INLINE &&
+          !--atom->value.string.storage.buffer->refs) {
+        string_buffer_free(atom->value.string.storage.buffer->data);
+      }
       break;
     case ATOM_TYPE_ERROR:
       free(atom->value.error.message);
       break;
+    case ATOM_TYPE_VECTOR:
+      free(atom->value.vector.items);
+      gc_forget_external(atom->value.vector.cap * sizeof(struct atom *));
+      break;
+    case ATOM_TYPE_TABLE:
+      table_gc_erase(atom);
+      break;
+    case ATOM_TYPE_ARRAY:
+      array_gc_erase(atom);
+      break;
+    case ATOM_TYPE_BIGNUM:
+      bignum_gc_erase(atom);
+      break;
     default:
       break;
   }
@@ -83,11 +319,11 @@ struct atom *car(struct atom *atom) {
     return atom;
   }
 
-  if (atom->type != ATOM_TYPE_CONS) {
+  if (!is_cons(atom)) {
     return new_atom_error(atom, "'car' requires a non-empty list");
   }
 
-  struct atom *result = atom->value.cons.car;
+  struct atom *result = atom_cons(atom)->car;
   if (!result) {
     return new_atom_error(atom, "'car' called on an empty list");
   }
@@ -100,11 +336,11 @@ struct atom *cdr(struct atom *atom) {
     return atom;
   }
 
-  if (atom->type != ATOM_TYPE_CONS) {
+  if (!is_cons(atom)) {
     return new_atom_error(atom, "'cdr' requires a non-empty list");
   }
 
-  struct atom *result = atom->value.cons.cdr;
+  struct atom *result = atom_cons(atom)->cdr;
   if (!result) {
     return new_atom_error(atom, "'cdr' called on an empty list");
   }
@@ -112,32 +348,56 @@ struct atom *cdr(struct atom *atom) {
   return result;
 }
 
+struct cons *atom_cons(struct atom *atom) {
+  return (struct cons *)atom;
+}
+
 int is_cons(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_CONS;
+  return atom && !is_static_atom(atom) && gc_type_of(atom) == GC_TYPE_CONS;
 }
 
 int is_nil(struct atom *atom) {
   return atom == &g_atom_nil;
 }
 
+int is_vector(struct atom *atom) {
+  return atom && atom_type_of(atom) == ATOM_TYPE_VECTOR;
+}
+
+int is_table(struct atom *atom) {
+  return atom && atom_type_of(atom) == ATOM_TYPE_TABLE;
+}
+
+int is_array(struct atom *atom) {
+  return atom && atom_type_of(atom) == ATOM_TYPE_ARRAY;
+}
+
 int is_symbol(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_SYMBOL;
+  return atom && atom_type_of(atom) == ATOM_TYPE_SYMBOL;
 }
 
 int is_keyword(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_KEYWORD;
+  return atom && atom_type_of(atom) == ATOM_TYPE_KEYWORD;
 }
 
 int is_string(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_STRING;
+  return atom && atom_type_of(atom) == ATOM_TYPE_STRING;
 }
 
 int is_int(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_INT;
+  return atom && atom_type_of(atom) == ATOM_TYPE_INT;
+}
+
+int is_bignum(struct atom *atom) {
+  return atom && atom_type_of(atom) == ATOM_TYPE_BIGNUM;
+}
+
+int is_local(struct atom *atom) {
+  return atom && atom_type_of(atom) == ATOM_TYPE_LOCAL;
 }
 
 int is_float(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_FLOAT;
+  return atom && atom_type_of(atom) == ATOM_TYPE_FLOAT;
 }
 
 int is_true(struct atom *atom) {
@@ -145,30 +405,102 @@ int is_true(struct atom *atom) {
 }
 
 int is_basic_type(struct atom *atom) {
-  return atom && (atom->type == ATOM_TYPE_INT || atom->type == ATOM_TYPE_FLOAT ||
-                  atom->type == ATOM_TYPE_STRING || atom->type == ATOM_TYPE_NIL ||
-                  atom->type == ATOM_TYPE_TRUE);
+  if (!atom) {
+    return 0;
+  }
+
+  enum AtomType type = atom_type_of(atom);
+  return type == ATOM_TYPE_INT || type == ATOM_TYPE_FLOAT || type == ATOM_TYPE_STRING ||
+         type == ATOM_TYPE_NIL || type == ATOM_TYPE_TRUE || type == ATOM_TYPE_VECTOR ||
+         type == ATOM_TYPE_TABLE || type == ATOM_TYPE_ARRAY || type == ATOM_TYPE_BIGNUM;
 }
 
 int is_error(struct atom *atom) {
   // EOF is a special case of error, so we include it here
-  return atom && (atom->type == ATOM_TYPE_ERROR || atom->type == ATOM_TYPE_EOF);
+  return atom && (atom_type_of(atom) == ATOM_TYPE_ERROR || atom_type_of(atom) == ATOM_TYPE_EOF);
 }
 
 int is_lambda(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_LAMBDA;
+  return atom && atom_type_of(atom) == ATOM_TYPE_LAMBDA;
 }
 
 int is_primitive(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_PRIMITIVE;
+  return atom && atom_type_of(atom) == ATOM_TYPE_PRIMITIVE;
 }
 
 int is_special(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_SPECIAL;
+  return atom && atom_type_of(atom) == ATOM_TYPE_SPECIAL;
 }
 
 int is_eof(struct atom *atom) {
-  return atom && atom->type == ATOM_TYPE_EOF;
+  return atom && atom_type_of(atom) == ATOM_TYPE_EOF;
+}
+
+#ifdef QUANTA_NAN_BOXING
+
+int is_fixnum(struct atom *atom) {
+  return ((uint64_t)(uintptr_t)atom & ATOM_NAN_TAG_MASK) == ATOM_FIXNUM_TAG;
+}
+
+int is_immediate(struct atom *atom) {
+  return ((uint64_t)(uintptr_t)atom & ATOM_NAN_TAG_MASK) != 0;
+}
+
+enum AtomType atom_type_of(struct atom *atom) {
+  if (is_immediate(atom)) {
+    return is_fixnum(atom) ? ATOM_TYPE_INT : ATOM_TYPE_FLOAT;
+  }
+
+  return is_cons(atom) ? ATOM_TYPE_CONS : atom->type;
+}
+
+int64_t atom_int(struct atom *atom) {
+  // Shift the tag out and back in arithmetically, to sign-extend the 48-bit value.
+  return is_fixnum(atom) ? (int64_t)((uint64_t)(uintptr_t)atom << 16) >> 16 : atom->value.ivalue;
+}
+
+double atom_float(struct atom *atom) {
+  if (!is_immediate(atom)) {
+    return atom->value.fvalue;
+  }
+
+  uint64_t bits = (uint64_t)(uintptr_t)atom - ATOM_DOUBLE_OFFSET;
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+#else
+
+int is_fixnum(struct atom *atom) {
+  return ((uintptr_t)atom & ATOM_FIXNUM_TAG) != 0;
+}
+
+int is_immediate(struct atom *atom) {
+  return is_fixnum(atom);
+}
+
+enum AtomType atom_type_of(struct atom *atom) {
+  if (is_fixnum(atom)) {
+    return ATOM_TYPE_INT;
+  }
+
+  return is_cons(atom) ? ATOM_TYPE_CONS : atom->type;
+}
+
+int64_t atom_int(struct atom *atom) {
+  // Arithmetic shift, to keep the sign.
+  return is_fixnum(atom) ? (int64_t)(intptr_t)atom >> 1 : atom->value.ivalue;
+}
+
+double atom_float(struct atom *atom) {
+  return atom->value.fvalue;
+}
+
+#endif  // QUANTA_NAN_BOXING
+
+int is_static_atom(struct atom *atom) {
+  return atom == &g_atom_nil || atom == &g_atom_true || atom == &g_atom_eof || is_immediate(atom);
 }
 
 const char *atom_type_to_string(enum AtomType type) {
@@ -191,6 +523,16 @@ const char *atom_type_to_string(enum AtomType type) {
       return "CONS";
     case ATOM_TYPE_LAMBDA:
       return "LAMBDA";
+    case ATOM_TYPE_VECTOR:
+      return "VECTOR";
+    case ATOM_TYPE_TABLE:
+      return "TABLE";
+    case ATOM_TYPE_ARRAY:
+      return "ARRAY";
+    case ATOM_TYPE_BIGNUM:
+      return "BIGNUM";
+    case ATOM_TYPE_LOCAL:
+      return "LOCAL";
     case ATOM_TYPE_ERROR:
       return "ERROR";
     default:
@@ -199,19 +541,36 @@ const char *atom_type_to_string(enum AtomType type) {
 }
 
 void atom_mark(struct atom *atom) {
-  if (!atom || atom == &g_atom_nil || atom == &g_atom_true || atom == &g_atom_eof) {
+  if (!atom || is_static_atom(atom)) {
     return;
   }
 
-  if (gc_mark(atom)) {
-    // already marked, don't recurse
-    return;
-  }
+  // the GC traces the children of newly marked atoms via atom_mark_children
+  gc_mark(atom);
+}
+
+void atom_mark_children(struct atom *atom) {
+  // When we mark a cons cell we need to mark its contents too. Lists are walked along their cdr
+  // chain here, so only car branches are queued and long lists don't grow the mark stack. The
+  // walk is capped to keep incremental marking slices short.
+  for (size_t walked = 0; gc_type_of(atom) == GC_TYPE_CONS; ++walked) {
+    atom_mark(atom_cons(atom)->car);
 
-  // When we mark a cons cell we need to mark its contents too.
-  if (atom->type == ATOM_TYPE_CONS) {
-    atom_mark(atom->value.cons.car);
-    atom_mark(atom->value.cons.cdr);
+    struct atom *next = atom_cons(atom)->cdr;
+    if (!next || is_static_atom(next)) {
+      return;
+    }
+
+    if (walked == ATOM_MARK_CDR_LIMIT) {
+      atom_mark(next);
+      return;
+    }
+
+    if (gc_set_mark(next)) {
+      return;
+    }
+
+    atom = next;
   }
 
   if (atom->type == ATOM_TYPE_LAMBDA) {
@@ -223,6 +582,60 @@ void atom_mark(struct atom *atom) {
   if (atom->type == ATOM_TYPE_ERROR) {
     atom_mark(atom->value.error.cause);
   }
+
+  if (atom->type == ATOM_TYPE_LOCAL) {
+    atom_mark(atom->value.local.symbol);
+  }
+
+  if (atom->type == ATOM_TYPE_VECTOR) {
+    for (size_t i = 0; i < atom->value.vector.len; ++i) {
+      atom_mark(atom->value.vector.items[i]);
+    }
+  }
+
+  if (atom->type == ATOM_TYPE_TABLE) {
+    table_gc_mark_children(atom);
+  }
+}
+
+void atom_update_children(struct atom *atom) {
+  if (gc_type_of(atom) == GC_TYPE_CONS) {
+    atom_cons(atom)->car = gc_forward(atom_cons(atom)->car);
+    atom_cons(atom)->cdr = gc_forward(atom_cons(atom)->cdr);
+    return;
+  }
+
+  switch (atom->type) {
+    case ATOM_TYPE_LAMBDA:
+      atom->value.lambda.args = gc_forward(atom->value.lambda.args);
+      atom->value.lambda.body = gc_forward(atom->value.lambda.body);
+      atom->value.lambda.env = gc_forward(atom->value.lambda.env);
+      break;
+    case ATOM_TYPE_ERROR:
+      atom->value.error.cause = gc_forward(atom->value.error.cause);
+      break;
+    case ATOM_TYPE_LOCAL:
+      atom->value.local.symbol = gc_forward(atom->value.local.symbol);
+      break;
+    case ATOM_TYPE_VECTOR:
+      for (size_t i = 0; i < atom->value.vector.len; ++i) {
+        atom->value.vector.items[i] = gc_forward(atom->value.vector.items[i]);
+      }
+      break;
+    case ATOM_TYPE_TABLE:
+      table_gc_update_children(atom);
+      break;
+    case ATOM_TYPE_STRING:
+    case ATOM_TYPE_SYMBOL:
+    case ATOM_TYPE_KEYWORD:
+      // a moved short string still points at the inline buffer of its old copy
+      if (atom->value.string.len < ATOM_STRING_INLINE) {
+        atom->value.string.ptr = atom->value.string.storage.small;
+      }
+      break;
+    default:
+      break;
+  }
 }
 
 struct atom *new_atom_error(struct atom *cause, const char *message, ...) {
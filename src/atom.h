@@ -21,12 +21,49 @@ enum AtomType {
   ATOM_TYPE_LAMBDA = 10,    // user-defined functions
   ATOM_TYPE_ERROR = 11,     // error, to propagate errors in evaluation
   ATOM_TYPE_EOF = 12,       // end of file marker
+  ATOM_TYPE_VECTOR = 13,    // [1 2 3]
+  ATOM_TYPE_TABLE = 14,     // hash tables, see table.h
+  ATOM_TYPE_ARRAY = 15,     // unboxed arrays of integers or floats, see array.h
+  ATOM_TYPE_BIGNUM = 16,    // integers too large for an int64_t, see bignum.h
+  ATOM_TYPE_LOCAL = 17,     // a variable reference resolved to an environment slot, see resolve.h
 };
 
 #define ATOM_LAMBDA_FLAG_MACRO (1 << 0)
 
+// Strings (and symbols and keywords) shorter than this, counting the NUL terminator, are stored
+// inside the atom rather than in a separate allocation. Fits in the space taken by a lambda.
+#define ATOM_STRING_INLINE 16
+
+// Longer strings live in an immutable, reference-counted buffer that substrings share.
+struct string_buffer;
+struct table_entry;
+
+// Some atoms are immediates: rather than being allocated, they are encoded in the 64-bit atom
+// pointer itself. Integers and floats that don't fit an immediate are still heap atoms, so always
+// use atom_type_of, atom_int and atom_float rather than reading an atom's fields directly.
+#ifdef QUANTA_NAN_BOXING
+// NaN-boxing (the NAN_BOXING build option): the top 16 bits of the word select the representation.
+// Pointers have them clear (user-space addresses fit in 48 bits), fixnums have them all set and
+// hold a 48-bit integer below, and anything in between is a double, offset by 2^49 so that no
+// double (NaNs are canonicalized) can look like a pointer or a fixnum.
+#define ATOM_NAN_TAG_MASK 0xFFFF000000000000ULL
+#define ATOM_FIXNUM_TAG 0xFFFF000000000000ULL
+#define ATOM_DOUBLE_OFFSET (1ULL << 49)
+#define ATOM_FIXNUM_MAX ((INT64_C(1) << 47) - 1)
+#define ATOM_FIXNUM_MIN (-(INT64_C(1) << 47))
+#else
+// Small integers (fixnums) are shifted left by one with the low bit set. Heap atoms are always
+// 8-byte aligned, so the low bit of a real pointer is never set. Floats are always heap atoms.
+#define ATOM_FIXNUM_TAG 1
+#define ATOM_FIXNUM_MAX (INT64_MAX >> 1)
+#define ATOM_FIXNUM_MIN (INT64_MIN >> 1)
+#endif
+
 typedef struct atom *(*PrimitiveFunction)(struct atom *args, struct environment *env);
 
+// Cons cells are allocated as just their car and cdr, without the type and the rest of the atom
+// union: a pointer to one is a struct atom * like any other, but is only recognised as a cons by
+// the GC slab it lives in. Use atom_cons to get at its fields.
 struct cons {
   struct atom *car;
   struct atom *cdr;
@@ -35,11 +72,17 @@ struct cons {
 union atom_value {
   int64_t ivalue;
   double fvalue;
+  // Create with new_string or new_substring. Strings may contain NULs, and a substring's ptr
+  // isn't NUL-terminated, so always go by len. Short strings point at storage.small and are
+  // NUL-terminated, as are symbols and keywords.
   struct {
     char *ptr;
     size_t len;
+    union {
+      char small[ATOM_STRING_INLINE];
+      struct string_buffer *buffer;  // the shared buffer ptr points into, for longer strings
+    } storage;
   } string;
-  struct cons cons;
   PrimitiveFunction primitive;
   struct {
     struct atom *args;
@@ -51,10 +94,50 @@ union atom_value {
     char *message;
     struct atom *cause;
   } error;
+  // Create with new_vector. The items array is owned by the atom and freed when it's collected.
+  struct {
+    struct atom **items;
+    size_t len;
+    size_t cap;
+  } vector;
+  // Create with new_table (see table.h). The entries array is owned by the atom.
+  struct {
+    struct table_entry *entries;
+    size_t count;  // live entries
+    size_t used;   // live entries and tombstones
+    size_t cap;    // zero or a power of two
+  } table;
+  // Create with new_array (see array.h). The elements are owned by the atom.
+  struct {
+    enum AtomType element_type;  // ATOM_TYPE_INT (int64_t) or ATOM_TYPE_FLOAT (double)
+    size_t len;
+    union {
+      int64_t *ints;
+      double *floats;
+    } data;
+  } array;
+  // Created by the arithmetic in bignum.h, which only returns one for values that don't fit an
+  // int64_t. The digits are owned by the atom.
+  struct {
+    uint32_t *digits;  // base 2^32, least significant first, without leading zeros
+    size_t len;
+    int negative;
+  } bignum;
+  // Created by the resolver (see resolve.h) in place of a symbol naming a lambda parameter or let
+  // variable: the variable is in slot number slot of the environment depth parents up from the
+  // one the reference is evaluated in.
+  struct {
+    struct atom *symbol;
+    uint32_t depth;
+    uint32_t slot;
+  } local;
 };
 
 struct atom {
   enum AtomType type;
+  // Only for interned symbols and keywords: a small number unique to each, assigned by intern so
+  // that tables of per-symbol data can be arrays (see env.c). Fits in what would be padding.
+  uint32_t symbol_id;
   union atom_value value;
 };
 
@@ -66,23 +149,71 @@ struct atom *atom_nil(void);
 struct atom *atom_true(void);
 struct atom *atom_eof(void);
 
+// Allocates a heap atom. Use new_int for integers, which usually don't need allocating.
 struct atom *new_atom(enum AtomType type, union atom_value value);
 
+// Returns a string, symbol or keyword atom holding a copy of the first len bytes of ptr.
+struct atom *new_string(enum AtomType type, const char *ptr, size_t len);
+// Like new_string, but takes over ptr, which must come from string_buffer_new and hold at least
+// len + 1 bytes, without copying it. ptr[len] is set to NUL.
+struct atom *new_string_owned(enum AtomType type, char *ptr, size_t len);
+// Returns a string of len bytes of the given string atom, starting at start, which shares the
+// string's buffer rather than copying it. The range must be within the string.
+struct atom *new_substring(struct atom *string, size_t start, size_t len);
+// Like new_string, but allocates the symbol or keyword from slabs of its own, which compaction
+// never moves. Only intern should call this.
+struct atom *new_symbol(enum AtomType type, const char *name, size_t len);
+
+// Returns a vector of len elements, each set to fill (or nil if fill is NULL), or an error if
+// there isn't the memory for that many.
+struct atom *new_vector(size_t len, struct atom *fill);
+// Appends an element to a vector, growing its items array if needed. Returns the vector, or an
+// error if the items array can't grow.
+struct atom *vector_push(struct atom *vector, struct atom *item);
+
+// Allocates a string buffer with room for size bytes, to fill in and pass to new_string_owned.
+char *string_buffer_new(size_t size);
+// Grows a buffer from string_buffer_new that hasn't been passed to new_string_owned yet.
+char *string_buffer_resize(char *ptr, size_t size);
+// Frees a buffer from string_buffer_new that hasn't been passed to new_string_owned.
+void string_buffer_free(char *ptr);
+
+// Returns a malloc'd, NUL-terminated copy of a string atom's contents, for C APIs (e.g. fopen).
+char *atom_string_dup(struct atom *string);
+
+// Returns an integer atom, which is a fixnum unless the value is too large for one.
+struct atom *new_int(int64_t value);
+// Returns a float atom, which is an immediate when NaN-boxing.
+struct atom *new_float(double value);
+
 // Erase allocated memory inside an atom (e.g. strings)
 // Does not free other atoms (e.g. cons cells).
 void erase_atom(struct atom *atom);
 
 struct atom *new_cons(struct atom *car, struct atom *cdr);
 
+// Returns a list of count elements taken from items (or nil elements if items is NULL), ending in
+// tail instead of nil if tail is not NULL. The cells are allocated one after the other so that
+// walking the list walks memory in order, as far as the heap allows.
+struct atom *new_list(struct atom **items, size_t count, struct atom *tail);
+
 struct atom *car(struct atom *atom);
 struct atom *cdr(struct atom *atom);
 
+// Returns the fields of a cons atom, which must be a cons.
+struct cons *atom_cons(struct atom *atom);
+
 int is_cons(struct atom *atom);
 int is_nil(struct atom *atom);
+int is_vector(struct atom *atom);
+int is_table(struct atom *atom);
+int is_array(struct atom *atom);
 int is_symbol(struct atom *atom);
 int is_keyword(struct atom *atom);
 int is_string(struct atom *atom);
 int is_int(struct atom *atom);
+int is_bignum(struct atom *atom);
+int is_local(struct atom *atom);
 int is_float(struct atom *atom);
 int is_true(struct atom *atom);
 int is_basic_type(struct atom *atom);
@@ -91,11 +222,28 @@ int is_lambda(struct atom *atom);
 int is_primitive(struct atom *atom);
 int is_special(struct atom *atom);
 int is_eof(struct atom *atom);
+int is_fixnum(struct atom *atom);
+// Returns 1 for atoms encoded in the pointer itself (fixnums, and floats when NaN-boxing).
+int is_immediate(struct atom *atom);
+// Returns 1 for atoms that are not GC objects: the statically allocated atoms (nil, t, eof) and
+// immediates.
+int is_static_atom(struct atom *atom);
+
+// Returns the type of an atom, including immediates.
+enum AtomType atom_type_of(struct atom *atom);
+// Returns the value of an integer atom, fixnum or not.
+int64_t atom_int(struct atom *atom);
+// Returns the value of a float atom, immediate or not.
+double atom_float(struct atom *atom);
 
 const char *atom_type_to_string(enum AtomType type);
 
 // Exposed for GC
 void atom_mark(struct atom *atom);
+// Marks the atoms referenced by this atom, but not the atom itself.
+void atom_mark_children(struct atom *atom);
+// Points the references of this atom at their new addresses after a compacting collection.
+void atom_update_children(struct atom *atom);
 
 struct atom *new_atom_error(struct atom *cause, const char *message, ...);
 
@@ -0,0 +1,466 @@
+#include "bignum.h"
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+// Magnitudes are arrays of base 2^32 digits, least significant first, so that the product of two
+// digits (plus two more) fits a uint64_t. Multiplication switches from the schoolbook method to
+// Karatsuba's, which trades one of four half-size products for a few additions, once both
+// operands have at least this many digits.
+#define BIGNUM_KARATSUBA_THRESHOLD 32
+
+// The largest power of ten that fits a digit, used to convert to and from decimal.
+#define BIGNUM_DECIMAL_BASE 1000000000
+#define BIGNUM_DECIMAL_DIGITS 9
+
+// The sign and magnitude of an integer atom. Plain integers are spread over small.
+struct integer {
+  const uint32_t *digits;
+  size_t len;
+  int negative;
+  uint32_t small[2];
+};
+
+static void integer_of(struct atom *atom, struct integer *value) {
+  if (atom_type_of(atom) == ATOM_TYPE_BIGNUM) {
+    value->digits = atom->value.bignum.digits;
+    value->len = atom->value.bignum.len;
+    value->negative = atom->value.bignum.negative;
+    return;
+  }
+
+  int64_t i = atom_int(atom);
+  // negated as unsigned, which is defined for INT64_MIN too
+  uint64_t magnitude = i < 0 ? -(uint64_t)i : (uint64_t)i;
+  value->small[0] = (uint32_t)magnitude;
+  value->small[1] = (uint32_t)(magnitude >> 32);
+  value->digits = value->small;
+  value->len = value->small[1] ? 2 : value->small[0] ? 1 : 0;
+  value->negative = i < 0;
+}
+
+// Returns the length of a magnitude without its leading zero digits.
+static size_t mag_trim(const uint32_t *a, size_t len) {
+  while (len && !a[len - 1]) {
+    --len;
+  }
+
+  return len;
+}
+
+static int mag_compare(const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+  an = mag_trim(a, an);
+  bn = mag_trim(b, bn);
+  if (an != bn) {
+    return an < bn ? -1 : 1;
+  }
+
+  for (size_t i = an; i-- > 0;) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+
+  return 0;
+}
+
+// r = a + b, where an >= bn. r has room for an + 1 digits.
+static void mag_add(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+  uint64_t carry = 0;
+  for (size_t i = 0; i < an; ++i) {
+    carry += (uint64_t)a[i] + (i < bn ? b[i] : 0);
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+
+  r[an] = (uint32_t)carry;
+}
+
+// r = a - b, where a >= b and an >= bn. r has room for an digits.
+static void mag_sub(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+  uint64_t borrow = 0;
+  for (size_t i = 0; i < an; ++i) {
+    uint64_t difference = (uint64_t)a[i] - (i < bn ? b[i] : 0) - borrow;
+    r[i] = (uint32_t)difference;
+    borrow = difference >> 63;
+  }
+}
+
+// r += a, where an <= rn. A carry out of r's rn digits is dropped.
+static void mag_add_into(uint32_t *r, size_t rn, const uint32_t *a, size_t an) {
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i < an; ++i) {
+    carry += (uint64_t)r[i] + a[i];
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+
+  for (; carry && i < rn; ++i) {
+    carry += r[i];
+    r[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+}
+
+// r -= a, where r >= a and an <= rn.
+static void mag_sub_into(uint32_t *r, size_t rn, const uint32_t *a, size_t an) {
+  uint64_t borrow = 0;
+  size_t i = 0;
+  for (; i < an; ++i) {
+    uint64_t difference = (uint64_t)r[i] - a[i] - borrow;
+    r[i] = (uint32_t)difference;
+    borrow = difference >> 63;
+  }
+
+  for (; borrow && i < rn; ++i) {
+    uint64_t difference = (uint64_t)r[i] - borrow;
+    r[i] = (uint32_t)difference;
+    borrow = difference >> 63;
+  }
+}
+
+// r = a * b, filling all an + bn digits of r, which mustn't overlap a or b.
+static void mag_mul_schoolbook(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b,
+                               size_t bn) {
+  memset(r, 0, (an + bn) * sizeof(uint32_t));
+  for (size_t i = 0; i < bn; ++i) {
+    uint64_t carry = 0;
+    for (size_t j = 0; j < an; ++j) {
+      carry += (uint64_t)a[j] * b[i] + r[i + j];
+      r[i + j] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    r[i + an] = (uint32_t)carry;
+  }
+}
+
+// r = a * b, filling all an + bn digits of r, which mustn't overlap a or b.
+static void mag_mul(uint32_t *r, const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+  if (an < bn) {
+    const uint32_t *swap = a;
+    a = b;
+    b = swap;
+    size_t swap_len = an;
+    an = bn;
+    bn = swap_len;
+  }
+
+  if (bn < BIGNUM_KARATSUBA_THRESHOLD) {
+    mag_mul_schoolbook(r, a, an, b, bn);
+    return;
+  }
+
+  if (2 * bn <= an) {
+    // Splitting pays off for operands of about the same size, so multiply b by slices of a as
+    // long as b and add the products up.
+    memset(r, 0, (an + bn) * sizeof(uint32_t));
+    uint32_t *product = malloc(2 * bn * sizeof(uint32_t));
+    for (size_t i = 0; i < an; i += bn) {
+      size_t n = an - i < bn ? an - i : bn;
+      mag_mul(product, a + i, n, b, bn);
+      mag_add_into(r + i, an + bn - i, product, n + bn);
+    }
+    free(product);
+    return;
+  }
+
+  // With a = a1 * B^m + a0 and b = b1 * B^m + b0, where B = 2^32,
+  //   a * b = z2 * B^2m + z1 * B^m + z0
+  // where z0 = a0 * b0, z2 = a1 * b1 and z1 = (a0 + a1) * (b0 + b1) - z0 - z2.
+  size_t m = (an + 1) / 2;
+  size_t a1n = an - m;
+  size_t b1n = bn - m;  // bn > an / 2, so bn >= m
+
+  mag_mul(r, a, m, b, m);
+  mag_mul(r + 2 * m, a + m, a1n, b + m, b1n);
+
+  uint32_t *a_sum = malloc(4 * (m + 1) * sizeof(uint32_t));
+  uint32_t *b_sum = a_sum + m + 1;
+  uint32_t *z1 = b_sum + m + 1;
+  mag_add(a_sum, a, m, a + m, a1n);
+  mag_add(b_sum, b, m, b + m, b1n);
+  mag_mul(z1, a_sum, m + 1, b_sum, m + 1);
+  mag_sub_into(z1, 2 * m + 2, r, 2 * m);
+  mag_sub_into(z1, 2 * m + 2, r + 2 * m, a1n + b1n);
+  mag_add_into(r + m, an + bn - m, z1, mag_trim(z1, 2 * m + 2));
+  free(a_sum);
+}
+
+// q = a / d, returning the remainder. q may be a.
+static uint32_t mag_div_digit(uint32_t *q, const uint32_t *a, size_t an, uint32_t d) {
+  uint64_t remainder = 0;
+  for (size_t i = an; i-- > 0;) {
+    uint64_t dividend = (remainder << 32) | a[i];
+    q[i] = (uint32_t)(dividend / d);
+    remainder = dividend % d;
+  }
+
+  return (uint32_t)remainder;
+}
+
+// r = a << shift, where shift < 32, returning the digit shifted out of the top. r may be a.
+static uint32_t mag_shift_left(uint32_t *r, const uint32_t *a, size_t an, int shift) {
+  if (!shift) {
+    memmove(r, a, an * sizeof(uint32_t));
+    return 0;
+  }
+
+  uint32_t carry = 0;
+  for (size_t i = 0; i < an; ++i) {
+    uint32_t digit = a[i];
+    r[i] = (digit << shift) | carry;
+    carry = digit >> (32 - shift);
+  }
+
+  return carry;
+}
+
+// q = a / b by Knuth's algorithm D, where an >= bn >= 2 and b has no leading zeros. q has room
+// for an - bn + 1 digits.
+static void mag_div(uint32_t *q, const uint32_t *a, size_t an, const uint32_t *b, size_t bn) {
+  // Shifting both so that b's top bit is set makes the estimate of each quotient digit from the
+  // top two digits of the remainder at most two too large.
+  int shift = __builtin_clz(b[bn - 1]);
+  uint32_t *u = malloc((an + 1 + bn) * sizeof(uint32_t));
+  uint32_t *v = u + an + 1;
+  mag_shift_left(v, b, bn, shift);
+  u[an] = mag_shift_left(u, a, an, shift);
+
+  for (size_t j = an - bn + 1; j-- > 0;) {
+    uint64_t top = ((uint64_t)u[j + bn] << 32) | u[j + bn - 1];
+    uint64_t qhat = top / v[bn - 1];
+    uint64_t rhat = top % v[bn - 1];
+    while (qhat > UINT32_MAX || qhat * v[bn - 2] > ((rhat << 32) | u[j + bn - 2])) {
+      --qhat;
+      rhat += v[bn - 1];
+      if (rhat > UINT32_MAX) {
+        break;
+      }
+    }
+
+    // u[j, j + bn] -= qhat * v
+    uint64_t carry = 0;
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < bn; ++i) {
+      uint64_t product = qhat * v[i] + carry;
+      carry = product >> 32;
+      uint64_t difference = (uint64_t)u[i + j] - (uint32_t)product - borrow;
+      u[i + j] = (uint32_t)difference;
+      borrow = difference >> 63;
+    }
+    uint64_t difference = (uint64_t)u[j + bn] - carry - borrow;
+    u[j + bn] = (uint32_t)difference;
+
+    if (difference >> 63) {
+      // Rarely, the estimate is still one too large: add v back, dropping the carry out.
+      --qhat;
+      mag_add_into(u + j, bn + 1, v, bn);
+    }
+
+    q[j] = (uint32_t)qhat;
+  }
+
+  free(u);
+}
+
+// Returns the integer atom with the given sign and magnitude, which must come from malloc and is
+// taken over by the atom, or freed if the value fits a plain integer.
+static struct atom *integer_result(uint32_t *digits, size_t len, int negative) {
+  len = mag_trim(digits, len);
+  if (len <= 2) {
+    uint64_t magnitude = len ? digits[0] : 0;
+    if (len == 2) {
+      magnitude |= (uint64_t)digits[1] << 32;
+    }
+
+    if (magnitude <= (uint64_t)INT64_MAX + (negative ? 1 : 0)) {
+      free(digits);
+      // negated in two steps, so that -2^63 doesn't overflow
+      return new_int(negative && magnitude ? -(int64_t)(magnitude - 1) - 1 : (int64_t)magnitude);
+    }
+  }
+
+  struct atom *atom = gc_new(GC_TYPE_ATOM, sizeof(struct atom));
+  atom->type = ATOM_TYPE_BIGNUM;
+  atom->value.bignum.digits = digits;
+  atom->value.bignum.len = len;
+  atom->value.bignum.negative = negative;
+  gc_note_external(len * sizeof(uint32_t));
+  return atom;
+}
+
+// Returns a + b, with b's sign taken from b_negative, so that subtraction can flip it.
+static struct atom *integer_add(struct integer *a, struct integer *b, int b_negative) {
+  struct integer *larger = a;
+  struct integer *smaller = b;
+  int negative = a->negative;
+
+  if (a->negative == b_negative) {
+    if (a->len < b->len) {
+      larger = b;
+      smaller = a;
+    }
+
+    uint32_t *digits = malloc((larger->len + 1) * sizeof(uint32_t));
+    mag_add(digits, larger->digits, larger->len, smaller->digits, smaller->len);
+    return integer_result(digits, larger->len + 1, negative);
+  }
+
+  // Opposite signs: subtract the smaller magnitude from the larger, taking the larger's sign.
+  if (mag_compare(a->digits, a->len, b->digits, b->len) < 0) {
+    larger = b;
+    smaller = a;
+    negative = b_negative;
+  }
+
+  uint32_t *digits = malloc((larger->len + 1) * sizeof(uint32_t));
+  mag_sub(digits, larger->digits, larger->len, smaller->digits, smaller->len);
+  return integer_result(digits, larger->len, negative);
+}
+
+struct atom *bignum_add(struct atom *a, struct atom *b) {
+  struct integer x, y;
+  integer_of(a, &x);
+  integer_of(b, &y);
+  return integer_add(&x, &y, y.negative);
+}
+
+struct atom *bignum_sub(struct atom *a, struct atom *b) {
+  struct integer x, y;
+  integer_of(a, &x);
+  integer_of(b, &y);
+  return integer_add(&x, &y, !y.negative);
+}
+
+struct atom *bignum_mul(struct atom *a, struct atom *b) {
+  struct integer x, y;
+  integer_of(a, &x);
+  integer_of(b, &y);
+  if (!x.len || !y.len) {
+    return new_int(0);
+  }
+
+  uint32_t *digits = malloc((x.len + y.len) * sizeof(uint32_t));
+  mag_mul(digits, x.digits, x.len, y.digits, y.len);
+  return integer_result(digits, x.len + y.len, x.negative != y.negative);
+}
+
+struct atom *bignum_div(struct atom *a, struct atom *b) {
+  struct integer x, y;
+  integer_of(a, &x);
+  integer_of(b, &y);
+  if (!y.len) {
+    return new_atom_error(b, "division by zero");
+  }
+
+  if (mag_compare(x.digits, x.len, y.digits, y.len) < 0) {
+    return new_int(0);
+  }
+
+  size_t len = x.len - y.len + 1;
+  uint32_t *digits = malloc(x.len * sizeof(uint32_t));
+  if (y.len == 1) {
+    mag_div_digit(digits, x.digits, x.len, y.digits[0]);
+  } else {
+    mag_div(digits, x.digits, x.len, y.digits, y.len);
+  }
+
+  return integer_result(digits, len, x.negative != y.negative);
+}
+
+int bignum_compare(struct atom *a, struct atom *b) {
+  struct integer x, y;
+  integer_of(a, &x);
+  integer_of(b, &y);
+  if (x.negative != y.negative) {
+    return x.negative ? -1 : 1;
+  }
+
+  int result = mag_compare(x.digits, x.len, y.digits, y.len);
+  return x.negative ? -result : result;
+}
+
+struct atom *bignum_from_string(const char *text) {
+  int negative = *text == '-';
+  if (*text == '-' || *text == '+') {
+    ++text;
+  }
+
+  size_t len = strlen(text);
+  if (!len) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < len; ++i) {
+    if (!isdigit((unsigned char)text[i])) {
+      return NULL;
+    }
+  }
+
+  // Each chunk of decimal digits is less than a digit, so there are at most as many digits.
+  uint32_t *digits = malloc((len / BIGNUM_DECIMAL_DIGITS + 1) * sizeof(uint32_t));
+  size_t n = 0;
+  size_t chunk = len % BIGNUM_DECIMAL_DIGITS ? len % BIGNUM_DECIMAL_DIGITS : BIGNUM_DECIMAL_DIGITS;
+  for (size_t i = 0; i < len; i += chunk, chunk = BIGNUM_DECIMAL_DIGITS) {
+    uint32_t value = 0;
+    uint32_t scale = 1;
+    for (size_t k = 0; k < chunk; ++k) {
+      value = value * 10 + (uint32_t)(text[i + k] - '0');
+      scale *= 10;
+    }
+
+    // digits = digits * scale + value
+    uint64_t carry = value;
+    for (size_t k = 0; k < n; ++k) {
+      carry += (uint64_t)digits[k] * scale;
+      digits[k] = (uint32_t)carry;
+      carry >>= 32;
+    }
+    if (carry) {
+      digits[n++] = (uint32_t)carry;
+    }
+  }
+
+  return integer_result(digits, n, negative);
+}
+
+int bignum_print(char *buffer, size_t buffer_size, struct atom *bignum) {
+  size_t len = bignum->value.bignum.len;
+  uint32_t *digits = malloc(len * sizeof(uint32_t));
+  memcpy(digits, bignum->value.bignum.digits, len * sizeof(uint32_t));
+
+  // Peel off decimal chunks, least significant first. A digit holds a little over one chunk.
+  uint32_t *chunks = malloc((len * 10 / 9 + 2) * sizeof(uint32_t));
+  size_t count = 0;
+  do {
+    chunks[count++] = mag_div_digit(digits, digits, len, BIGNUM_DECIMAL_BASE);
+    len = mag_trim(digits, len);
+  } while (len);
+
+  size_t size = count * BIGNUM_DECIMAL_DIGITS + 2;  // the chunks, a sign and a NUL
+  char *text = malloc(size);
+  int offset = snprintf(text, size, "%s%" PRIu32, bignum->value.bignum.negative ? "-" : "",
+                        chunks[count - 1]);
+  for (size_t i = count - 1; i-- > 0;) {
+    offset += snprintf(text + offset, size - offset, "%09" PRIu32, chunks[i]);
+  }
+
+  int result = snprintf(buffer, buffer_size, "%s", text);
+  free(text);
+  free(chunks);
+  free(digits);
+  return result;
+}
+
+void bignum_gc_erase(struct atom *bignum) {
+  free(bignum->value.bignum.digits);
+  bignum->value.bignum.digits = NULL;
+  gc_forget_external(bignum->value.bignum.len * sizeof(uint32_t));
+}
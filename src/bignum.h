@@ -0,0 +1,36 @@
+#ifndef _QUANTA_BIGNUM_H
+#define _QUANTA_BIGNUM_H
+
+#include <stddef.h>
+
+#include "atom.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Arithmetic on integer atoms, either ATOM_TYPE_INT or ATOM_TYPE_BIGNUM. Results that fit an
+// int64_t are always returned as plain integers, so a bignum is never equal to an integer and
+// code that only sees small values never sees a bignum.
+struct atom *bignum_add(struct atom *a, struct atom *b);
+struct atom *bignum_sub(struct atom *a, struct atom *b);
+struct atom *bignum_mul(struct atom *a, struct atom *b);
+// Truncates towards zero, like C's integer division. Returns an error if b is zero.
+struct atom *bignum_div(struct atom *a, struct atom *b);
+
+// Returns -1, 0 or 1 as a is less than, equal to or greater than b.
+int bignum_compare(struct atom *a, struct atom *b);
+
+// Parses an optionally signed decimal integer of any size, returning NULL if text isn't one.
+struct atom *bignum_from_string(const char *text);
+// Prints a bignum in decimal, with the same return value and truncation as snprintf.
+int bignum_print(char *buffer, size_t buffer_size, struct atom *bignum);
+
+// Frees the bignum's digits.
+void bignum_gc_erase(struct atom *bignum);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // _QUANTA_BIGNUM_H
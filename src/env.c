@@ -4,6 +4,7 @@
 #include <glib-2.0/glib.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "atom.h"
 #include "gc.h"
@@ -15,11 +16,83 @@ struct binding_cell {
   struct atom *atom;
 };
 
+// Lambda calls and lets bind their slots and usually little else, so a frame keeps its bindings
+// in an array inside the environment itself, which holds this many before it moves to the heap.
+#define ENV_INLINE_BINDINGS 4
+
+// A frame binds at most this many symbols by name (rather than in a slot) in its array. Once it
+// binds more, as the global environment does, they move to a hash table.
+#define ENV_ARRAY_NAMED_BINDINGS 8
+
+struct env_binding {
+  struct atom *symbol;  // interned, so compared by identity; NULL for an unbound slot
+  struct atom *value;
+};
+
 struct environment {
-  GHashTable *bindings;        // char* -> struct binding_cell* bindings
-  struct environment *parent;  // for nested environments
+  struct environment *parent;    // for nested environments
+  struct environment *root;      // the end of the parent chain, possibly this environment
+  struct env_binding *bindings;  // the slots (see create_frame), then bindings by name
+  size_t count;                  // bindings in use, including unbound slots
+  size_t capacity;               // inline_bindings unless more than ENV_INLINE_BINDINGS
+  size_t slot_count;             // the bindings that are slots, bound by position
+  GHashTable *table;             // symbol -> struct binding_cell* for large frames, or NULL
+  // A root environment binds names in an array indexed by symbol id instead, so looking up a
+  // global is a couple of loads. NULL (and no capacity) until the first such binding.
+  struct binding_cell **globals;
+  size_t globals_capacity;
+  uint32_t shadow_epoch;  // the root's shadow_epoch when it was created
+  struct env_binding inline_bindings[ENV_INLINE_BINDINGS];
 };
 
+// How many bindings of each symbol (by symbol id) there are in all environments, other than in
+// the globals of root environments. A lookup of a symbol that nothing else binds can go straight
+// to the root of the environment chain, which is what makes looking up globals (and defines and
+// set!s of them) constant time however deeply nested the lookup is.
+static uint32_t *shadow_counts = NULL;
+static size_t shadow_capacity = 0;
+
+// Only environment chains whose root was created since the counts were last reset (see
+// env_reset_shadows) take part in them. Lookups in older ones walk the chain.
+static uint32_t shadow_epoch = 0;
+
+static int is_shadowed(struct environment *env, struct atom *symbol) {
+  return env->shadow_epoch != shadow_epoch ||
+         (symbol->symbol_id < shadow_capacity && shadow_counts[symbol->symbol_id]);
+}
+
+static void shadow(struct environment *env, struct atom *symbol) {
+  if (env->shadow_epoch != shadow_epoch) {
+    return;
+  }
+
+  if (symbol->symbol_id >= shadow_capacity) {
+    size_t capacity = shadow_capacity ? shadow_capacity : 256;
+    while (capacity <= symbol->symbol_id) {
+      capacity *= 2;
+    }
+
+    shadow_counts = realloc(shadow_counts, capacity * sizeof(uint32_t));
+    memset(shadow_counts + shadow_capacity, 0, (capacity - shadow_capacity) * sizeof(uint32_t));
+    shadow_capacity = capacity;
+  }
+
+  ++shadow_counts[symbol->symbol_id];
+}
+
+static void unshadow(struct environment *env, struct atom *symbol) {
+  if (env->shadow_epoch == shadow_epoch) {
+    --shadow_counts[symbol->symbol_id];
+  }
+}
+
+void env_reset_shadows(void) {
+  free(shadow_counts);
+  shadow_counts = NULL;
+  shadow_capacity = 0;
+  ++shadow_epoch;
+}
+
 struct environment *create_default_environment(void) {
   struct environment *env = create_environment(NULL);
   init_primitives(env);
@@ -28,30 +101,120 @@ struct environment *create_default_environment(void) {
 }
 
 struct environment *create_environment(struct environment *parent) {
+  return create_frame(parent, 0);
+}
+
+struct environment *create_frame(struct environment *parent, size_t slot_count) {
   struct environment *env = gc_new(GC_TYPE_ENVIRONMENT, sizeof(struct environment));
 
-  env->bindings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   env->parent = parent;
+  env->root = parent ? parent->root : env;
+  env->bindings = env->inline_bindings;
+  env->count = slot_count;
+  env->capacity = ENV_INLINE_BINDINGS;
+  env->slot_count = slot_count;
+  env->table = NULL;
+  env->globals = NULL;
+  env->globals_capacity = 0;
+  env->shadow_epoch = parent ? parent->shadow_epoch : shadow_epoch;
+
+  if (slot_count > ENV_INLINE_BINDINGS) {
+    env->bindings = malloc(slot_count * sizeof(struct env_binding));
+    env->capacity = slot_count;
+  }
+
+  for (size_t i = 0; i < slot_count; ++i) {
+    env->bindings[i].symbol = NULL;
+    env->bindings[i].value = NULL;
+  }
 
   return env;
 }
 
-struct environment *clone_environment(struct environment *env) {
-  if (!env) {
-    return NULL;  // nothing to clone
+// Symbols are interned and never moved by compaction, so their address is a stable hash that
+// costs nothing to compute, and equal symbols are the same atom.
+static guint symbol_hash(gconstpointer symbol) {
+  uint64_t x = (uint64_t)(uintptr_t)symbol;
+  return (guint)((x * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+static GHashTable *new_binding_table(void) {
+  return g_hash_table_new(symbol_hash, g_direct_equal);
+}
+
+// Makes room for one more binding in the frame's array.
+static void env_reserve(struct environment *env) {
+  if (env->count < env->capacity) {
+    return;
   }
 
-  struct environment *new_env = create_environment(env->parent);
+  size_t capacity = env->capacity * 2;
+  if (env->bindings == env->inline_bindings) {
+    env->bindings = malloc(capacity * sizeof(struct env_binding));
+    memcpy(env->bindings, env->inline_bindings, env->count * sizeof(struct env_binding));
+  } else {
+    env->bindings = realloc(env->bindings, capacity * sizeof(struct env_binding));
+  }
+  env->capacity = capacity;
+}
+
+// Binds symbol in a root environment's globals.
+static void env_add_global(struct environment *env, struct atom *symbol,
+                           struct binding_cell *cell) {
+  if (symbol->symbol_id >= env->globals_capacity) {
+    size_t capacity = env->globals_capacity ? env->globals_capacity : 256;
+    while (capacity <= symbol->symbol_id) {
+      capacity *= 2;
+    }
+
+    env->globals = realloc(env->globals, capacity * sizeof(struct binding_cell *));
+    memset(env->globals + env->globals_capacity, 0,
+           (capacity - env->globals_capacity) * sizeof(struct binding_cell *));
+    env->globals_capacity = capacity;
+  }
+
+  env->globals[symbol->symbol_id] = cell;
+  gc_write_barrier(env);
+}
+
+// Adds a binding by name: in a root environment's globals, or in the array or the hash table as
+// the frame's size calls for.
+static void env_add(struct environment *env, struct atom *symbol, struct atom *value) {
+  if (!env->parent) {
+    struct binding_cell *cell = gc_new(GC_TYPE_BINDING_CELL, sizeof(struct binding_cell));
+    cell->atom = value;
+    env_add_global(env, symbol, cell);
+    return;
+  }
+
+  shadow(env, symbol);
+
+  if (!env->table && env->count - env->slot_count >= ENV_ARRAY_NAMED_BINDINGS) {
+    env->table = new_binding_table();
+    for (size_t i = env->slot_count; i < env->count; ++i) {
+      struct binding_cell *cell = gc_new(GC_TYPE_BINDING_CELL, sizeof(struct binding_cell));
+      cell->atom = env->bindings[i].value;
+      g_hash_table_insert(env->table, env->bindings[i].symbol, cell);
+    }
+    env->count = env->slot_count;
+  }
 
-  // Copy bindings from the old environment
-  GHashTableIter iter;
-  gpointer key, value;
-  g_hash_table_iter_init(&iter, env->bindings);
-  while (g_hash_table_iter_next(&iter, &key, &value)) {
-    g_hash_table_insert(new_env->bindings, g_strdup(key), value);
+  if (env->table) {
+    struct binding_cell *cell = gc_new(GC_TYPE_BINDING_CELL, sizeof(struct binding_cell));
+    cell->atom = value;
+
+    clog_debug(CLOG(LOGGER_ENV), "Binding value for symbol '%s' in env cell %p",
+               symbol->value.string.ptr, (void *)cell);
+
+    g_hash_table_insert(env->table, symbol, cell);
+  } else {
+    env_reserve(env);
+    struct env_binding *binding = &env->bindings[env->count++];
+    binding->symbol = symbol;
+    binding->value = value;
   }
 
-  return new_env;
+  gc_write_barrier(env);
 }
 
 void erase_environment(struct environment *env) {
@@ -59,14 +222,84 @@ void erase_environment(struct environment *env) {
     return;
   }
 
-  g_hash_table_destroy(env->bindings);
+  for (size_t i = 0; i < env->count; ++i) {
+    if (env->bindings[i].symbol) {
+      unshadow(env, env->bindings[i].symbol);
+    }
+  }
+
+  if (env->table) {
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, env->table);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      unshadow(env, key);
+    }
+
+    g_hash_table_destroy(env->table);
+  }
+  if (env->bindings != env->inline_bindings) {
+    free(env->bindings);
+  }
+  free(env->globals);
+}
+
+// Returns the binding of symbol in the frame's array, or NULL.
+static struct env_binding *env_find_binding(struct environment *env, size_t start,
+                                            struct atom *symbol) {
+  for (size_t i = start; i < env->count; ++i) {
+    if (env->bindings[i].symbol == symbol) {
+      return &env->bindings[i];
+    }
+  }
+
+  return NULL;
 }
 
-static struct binding_cell *env_lookup_cell(struct environment *env, struct atom *symbol) {
+// Finds symbol's binding in this environment only: returns its value and sets *owner to the
+// object holding it (for env_set's write barrier), or returns NULL. Bindings start at index start
+// of the frame's array.
+static struct atom **env_find(struct environment *env, size_t start, struct atom *symbol,
+                              void **owner) {
+  struct env_binding *binding = env_find_binding(env, start, symbol);
+  if (binding) {
+    *owner = env;
+    return &binding->value;
+  }
+
+  struct binding_cell *cell = NULL;
+  if (env->table) {
+    cell = g_hash_table_lookup(env->table, symbol);
+  } else if (symbol->symbol_id < env->globals_capacity) {
+    cell = env->globals[symbol->symbol_id];
+  }
+
+  if (cell) {
+    *owner = cell;
+    return &cell->atom;
+  }
+
+  return NULL;
+}
+
+static struct atom **env_lookup_value(struct environment *env, struct atom *symbol,
+                                      void **owner) {
+  if (env && !is_shadowed(env, symbol)) {
+    // only a root environment can bind it
+    struct environment *root = env->root;
+    if (symbol->symbol_id < root->globals_capacity && root->globals[symbol->symbol_id]) {
+      struct binding_cell *cell = root->globals[symbol->symbol_id];
+      *owner = cell;
+      return &cell->atom;
+    }
+
+    return NULL;
+  }
+
   while (env) {
-    struct binding_cell *cell = g_hash_table_lookup(env->bindings, symbol->value.string.ptr);
-    if (cell) {
-      return cell;
+    struct atom **value = env_find(env, 0, symbol, owner);
+    if (value) {
+      return value;
     }
 
     env = env->parent;
@@ -75,48 +308,93 @@ static struct binding_cell *env_lookup_cell(struct environment *env, struct atom
 }
 
 struct atom *env_lookup(struct environment *env, struct atom *symbol) {
-  struct binding_cell *cell = env_lookup_cell(env, symbol);
-  if (cell) {
-    clog_debug(CLOG(LOGGER_ENV), "Found binding for symbol '%s' in env cell %p",
-               symbol->value.string.ptr, (void *)cell);
-    return cell->atom;
+  void *owner = NULL;
+  struct atom **value = env_lookup_value(env, symbol, &owner);
+  if (value) {
+    clog_debug(CLOG(LOGGER_ENV), "Found binding for symbol '%s' in %p", symbol->value.string.ptr,
+               owner);
+    return *value;
   }
 
   return NULL;
 }
 
+struct atom *env_lookup_local(struct environment *env, struct atom *local) {
+  struct atom *symbol = local->value.local.symbol;
+
+  struct environment *frame = env;
+  for (uint32_t depth = local->value.local.depth; depth && frame; --depth) {
+    // a define in a frame in between shadows the variable, which the resolver can't see coming
+    if (frame->count > frame->slot_count || frame->table) {
+      void *owner = NULL;
+      struct atom **value = env_find(frame, frame->slot_count, symbol, &owner);
+      if (value) {
+        return *value;
+      }
+    }
+
+    frame = frame->parent;
+  }
+
+  uint32_t slot = local->value.local.slot;
+  if (frame && slot < frame->slot_count && frame->bindings[slot].symbol == symbol) {
+    return frame->bindings[slot].value;
+  }
+
+  // Only a frame laid out differently from what the resolver saw (or a slot referenced before
+  // it's bound) gets here, so fall back to a lookup by name.
+  return env_lookup(env, symbol);
+}
+
 struct atom *env_bind(struct environment *env, struct atom *symbol, struct atom *value) {
   if (!is_symbol(symbol)) {
     return new_atom_error(symbol, "Error: env_bind requires a symbol, got %s",
-                          atom_type_to_string(symbol->type));
+                          atom_type_to_string(atom_type_of(symbol)));
   }
 
-  if (g_hash_table_contains(env->bindings, symbol->value.string.ptr)) {
+  void *owner = NULL;
+  if (env_find(env, 0, symbol, &owner)) {
     clog_debug(CLOG(LOGGER_ENV), "Warning: env_bind called on already bound symbol '%s'",
                symbol->value.string.ptr);
     return new_atom_error(symbol, "Error: symbol '%s' is already bound in this environment",
                           symbol->value.string.ptr);
   }
 
-  struct binding_cell *cell = gc_new(GC_TYPE_BINDING_CELL, sizeof(struct binding_cell));
-  cell->atom = value;
+  env_add(env, symbol, value);
 
-  clog_debug(CLOG(LOGGER_ENV), "Binding value for symbol '%s' in env cell %p",
-             symbol->value.string.ptr, (void *)cell);
+  return symbol;
+}
 
-  // key is an interned string, value is the real atom value
-  // the binding should not outlive the atom
-  g_hash_table_insert(env->bindings, g_strdup(symbol->value.string.ptr), cell);
+struct atom *env_bind_slot(struct environment *env, size_t slot, struct atom *symbol,
+                           struct atom *value) {
+  if (!is_symbol(symbol)) {
+    return new_atom_error(symbol, "Error: env_bind requires a symbol, got %s",
+                          atom_type_to_string(atom_type_of(symbol)));
+  }
+
+  void *owner = NULL;
+  if (env_find(env, 0, symbol, &owner)) {
+    return new_atom_error(symbol, "Error: symbol '%s' is already bound in this environment",
+                          symbol->value.string.ptr);
+  }
+
+  struct env_binding *binding = &env->bindings[slot];
+  binding->symbol = symbol;
+  binding->value = value;
+  shadow(env, symbol);
+  gc_write_barrier(env);
 
   return symbol;
 }
 
 struct atom *env_set(struct environment *env, struct atom *symbol, struct atom *value) {
-  struct binding_cell *cell = env_lookup_cell(env, symbol);
-  if (cell) {
-    clog_debug(CLOG(LOGGER_ENV), "Setting value for symbol '%s' in env cell %p",
-               symbol->value.string.ptr, (void *)cell);
-    cell->atom = value;
+  void *owner = NULL;
+  struct atom **location = env_lookup_value(env, symbol, &owner);
+  if (location) {
+    clog_debug(CLOG(LOGGER_ENV), "Setting value for symbol '%s' in %p", symbol->value.string.ptr,
+               owner);
+    *location = value;
+    gc_write_barrier(owner);
     return symbol;
   }
 
@@ -132,26 +410,82 @@ void environment_gc_mark(struct environment *env) {
     return;  // nothing to mark
   }
 
-  if (gc_mark(env)) {
-    // already marked, no need to recurse
-    return;
-  }
+  // the GC traces the bindings of newly marked environments via environment_gc_mark_children
+  gc_mark(env);
+}
 
-  GHashTableIter iter;
-  gpointer key, value;
-  g_hash_table_iter_init(&iter, env->bindings);
-  while (g_hash_table_iter_next(&iter, &key, &value)) {
-    struct binding_cell *cell = (struct binding_cell *)value;
-    if (gc_mark(cell)) {
-      continue;
+void environment_gc_mark_children(struct environment *env) {
+  for (size_t i = 0; i < env->count; ++i) {
+    struct env_binding *binding = &env->bindings[i];
+    if (binding->symbol) {
+      atom_mark(binding->symbol);
+      atom_mark(binding->value);
     }
+  }
 
-    if (cell && cell->atom) {
-      atom_mark(cell->atom);
+  if (env->table) {
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, env->table);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      atom_mark((struct atom *)key);
+      binding_cell_gc_mark((struct binding_cell *)value);
     }
   }
 
+  for (size_t i = 0; i < env->globals_capacity; ++i) {
+    binding_cell_gc_mark(env->globals[i]);
+  }
+
   if (env->parent) {
     environment_gc_mark(env->parent);
   }
 }
+
+void environment_gc_update_children(struct environment *env) {
+  // a moved environment's inline bindings moved with it
+  if (env->capacity == ENV_INLINE_BINDINGS) {
+    env->bindings = env->inline_bindings;
+  }
+
+  for (size_t i = 0; i < env->count; ++i) {
+    struct env_binding *binding = &env->bindings[i];
+    if (binding->symbol) {
+      binding->symbol = gc_forward(binding->symbol);
+      binding->value = gc_forward(binding->value);
+    }
+  }
+
+  if (env->table) {
+    GHashTableIter iter;
+    gpointer key, value;
+    // the keys are symbols, which are never moved, so the entries stay where they are
+    g_hash_table_iter_init(&iter, env->table);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      g_hash_table_iter_replace(&iter, gc_forward(value));
+    }
+  }
+
+  for (size_t i = 0; i < env->globals_capacity; ++i) {
+    env->globals[i] = gc_forward(env->globals[i]);
+  }
+
+  env->parent = gc_forward(env->parent);
+  env->root = gc_forward(env->root);
+}
+
+void binding_cell_gc_mark(struct binding_cell *cell) {
+  if (cell) {
+    gc_mark(cell);
+  }
+}
+
+void binding_cell_gc_mark_children(struct binding_cell *cell) {
+  if (cell->atom) {
+    atom_mark(cell->atom);
+  }
+}
+
+void binding_cell_gc_update_children(struct binding_cell *cell) {
+  cell->atom = gc_forward(cell->atom);
+}
@@ -1,7 +1,10 @@
 #ifndef _QUANTA_ENV_H
 #define _QUANTA_ENV_H
 
+#include <stddef.h>
+
 struct environment;
+struct binding_cell;
 
 #ifdef __cplusplus
 extern "C" {
@@ -9,19 +12,39 @@ extern "C" {
 
 struct environment *create_default_environment(void);
 struct environment *create_environment(struct environment *parent);
-
-struct environment *clone_environment(struct environment *env);
+// Creates an environment for a lambda call or a let, with slot_count slots for the variables it
+// binds, which the resolver refers to by position (see resolve.h). Bind them in order with
+// env_bind_slot.
+struct environment *create_frame(struct environment *parent, size_t slot_count);
+
+// Starts counting which symbols are bound outside the globals afresh, for when the symbols bound
+// so far are about to be collected along with the environments binding them, which then mustn't
+// read them. Environments created before this no longer take part: erasing one leaves its
+// symbols alone, and lookups in one walk the environment chain instead of going straight to the
+// globals. Environments created after it look up globals in constant time as before.
+void env_reset_shadows(void);
 
 // Frees resources associated with an environment (e.g. hash tables).
 // Does not free atoms referenced in the environment, GC will handle that.
 void erase_environment(struct environment *env);
 
 struct atom *env_lookup(struct environment *env, struct atom *symbol);
+// Returns the value of a variable reference created by the resolver, or NULL if it's unbound.
+struct atom *env_lookup_local(struct environment *env, struct atom *local);
 
 struct atom *env_bind(struct environment *env, struct atom *symbol, struct atom *value);
+// Binds symbol in a frame's slot number slot, which must be less than the frame's slot count.
+struct atom *env_bind_slot(struct environment *env, size_t slot, struct atom *symbol,
+                           struct atom *value);
 struct atom *env_set(struct environment *env, struct atom *symbol, struct atom *value);
 
 void environment_gc_mark(struct environment *env);
+void environment_gc_mark_children(struct environment *env);
+void environment_gc_update_children(struct environment *env);
+
+void binding_cell_gc_mark(struct binding_cell *cell);
+void binding_cell_gc_mark_children(struct binding_cell *cell);
+void binding_cell_gc_update_children(struct binding_cell *cell);
 
 #ifdef __cplusplus
 }  // extern "C"
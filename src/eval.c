@@ -10,29 +10,41 @@
 #include "gc.h"
 #include "log.h"
 #include "print.h"
+#include "special.h"
 
 static const int ENABLE_TCO = 1;
 
 // Evaluates the given list and its sublists, if necessary, in the provided environment.
 static struct atom *eval_list(struct atom *list, struct environment *env);
 
-// Binds the arguments in the environment based on the binding list and the provided arguments.
+// Binds the already-evaluated arguments in the environment based on the binding list.
 static struct atom *bind_arguments(struct environment *env, struct atom *binding_list,
-                                   struct atom *args, int should_eval);
+                                   struct atom *args);
 
 static struct atom *apply_macro(struct atom *fn, struct atom *args, struct environment *env);
 
-// Used to track shadow stack for roots in functions like eval_list
-struct shadow_root {
-  struct atom *atom;
-  struct shadow_root *next;
-};
+// Creates the environment for a call to the lambda, with a slot for each parameter.
+static struct environment *create_lambda_frame(struct atom *fn) {
+  size_t count = 0;
+  for (struct atom *param = fn->value.lambda.args; is_cons(param); param = cdr(param)) {
+    ++count;
+  }
+
+  return create_frame(fn->value.lambda.env, count);
+}
 
 struct atom *eval(struct atom *atom, struct environment *env) {
   static char buf[1024];
 
   size_t iter = 0;
 
+  struct atom *result = NULL;
+  struct atom *fn = NULL;
+  struct atom *args = NULL;
+
+  // eval recurses and reaches GC safe points, so everything it's still using must stay rooted
+  GC_PUSH_FRAME(frame, GC_ROOT(atom), GC_ROOT(env), GC_ROOT(fn), GC_ROOT(args));
+
   while (1) {
     print_str(buf, 1024, atom, 0);
     clog_debug(CLOG(LOGGER_EVAL), "eval [%zu]: %p %s", iter, (void *)atom, buf);
@@ -40,37 +52,50 @@ struct atom *eval(struct atom *atom, struct environment *env) {
     ++iter;
 
     if (!atom || is_basic_type(atom)) {
-      return atom;
+      result = atom;
+      break;
+    }
+
+    if (atom_type_of(atom) == ATOM_TYPE_LOCAL) {
+      result = env_lookup_local(env, atom);
+      if (!result) {
+        result = new_atom_error(atom, "unbound symbol '%s'",
+                                atom->value.local.symbol->value.string.ptr);
+      }
+      break;
     }
 
-    if (atom->type == ATOM_TYPE_SYMBOL) {
+    if (atom_type_of(atom) == ATOM_TYPE_SYMBOL) {
       struct atom *value = env_lookup(env, atom);
       if (!value) {
-        return new_atom_error(atom, "unbound symbol '%s'", atom->value.string.ptr);
+        result = new_atom_error(atom, "unbound symbol '%s'", atom->value.string.ptr);
+      } else {
+        result = value;
       }
-
-      return value;
+      break;
     }
 
-    if (atom->type == ATOM_TYPE_CONS) {
+    if (atom_type_of(atom) == ATOM_TYPE_CONS) {
       struct atom *eval_car = car(atom);
       struct atom *eval_cdr = cdr(atom);
 
-      struct atom *fn = eval(eval_car, env);
+      fn = eval(eval_car, env);
       if (is_error(fn)) {
-        return fn;
+        result = fn;
+        break;
       }
 
       int eval_args = 1;
-      if (fn->type == ATOM_TYPE_SPECIAL) {
+      if (atom_type_of(fn) == ATOM_TYPE_SPECIAL) {
         eval_args = 0;
-      } else if (fn->value.lambda.flags & ATOM_LAMBDA_FLAG_MACRO) {
+      } else if (is_lambda(fn) && (fn->value.lambda.flags & ATOM_LAMBDA_FLAG_MACRO)) {
         eval_args = 0;
       }
 
-      struct atom *args = eval_args ? eval_list(eval_cdr, env) : eval_cdr;
+      args = eval_args ? eval_list(eval_cdr, env) : eval_cdr;
       if (is_error(args)) {
-        return args;
+        result = args;
+        break;
       }
 
       if (is_lambda(fn) && (fn->value.lambda.flags & ATOM_LAMBDA_FLAG_MACRO)) {
@@ -78,105 +103,100 @@ struct atom *eval(struct atom *atom, struct environment *env) {
         struct atom *expanded = apply_macro(fn, args, env);
         print_str(buf, 1024, expanded, 0);
         clog_debug(CLOG(LOGGER_EVAL), "expanded macro %s to %s", eval_car->value.string.ptr, buf);
-        return eval(expanded, env);
+        result = eval(expanded, env);
+        break;
+      }
+
+      // special forms with a tail position continue here with their tail expression
+      TailSpecialFunction tail_special = is_special(fn) ? special_form_tail(fn) : NULL;
+      if (ENABLE_TCO && tail_special) {
+        struct atom *tail = NULL;
+        result = tail_special(args, &env, &tail);
+        if (result) {
+          break;
+        }
+
+        atom = tail;
+        continue;
       }
 
       if (!ENABLE_TCO || !is_lambda(fn)) {
-        return apply(fn, args, env);
+        result = apply(fn, args, env);
+        break;
       }
 
-      // run GC before TCO loop to avoid unbounded memory growth
-      // this also averages out to better performance as the stop-the-world is shorter
-      gc_retain(args);
-      gc_retain(fn);
-      gc_run();
+      // the TCO loop is a safe point for GC, which avoids unbounded memory growth
+      // collections only actually happen once enough has been allocated to make one due
+      gc_maybe_run();
 
       // tail-call optimization - iteratively evaluate so we don't recurse
       atom = fn->value.lambda.body;
-      env = create_environment(fn->value.lambda.env);
-      struct atom *error = bind_arguments(env, fn->value.lambda.args, args, 1);
-
-      gc_release(args);
-      gc_release(fn);
-
+      env = create_lambda_frame(fn);
+      struct atom *error = bind_arguments(env, fn->value.lambda.args, args);
       if (error) {
-        return error;
+        result = error;
+        break;
       }
       continue;
     }
 
-    return atom;
+    result = atom;
+    break;
   }
+
+  GC_POP_FRAME(frame);
+  return result;
 }
 
 static struct atom *eval_list(struct atom *atom, struct environment *env) {
   static char buf[1024];
 
-  if (atom->type != ATOM_TYPE_CONS) {
+  if (atom_type_of(atom) != ATOM_TYPE_CONS) {
     return atom;
   }
 
   print_str(buf, 1024, atom, 0);
   clog_debug(CLOG(LOGGER_EVAL), "eval_list: %p %s", (void *)atom, buf);
 
-  struct atom *head = NULL;
-  struct atom *tail = NULL;
+  // the result has one cell per argument, so allocate them up front where they can sit next to
+  // each other and fill in the cars as the arguments are evaluated
+  size_t count = 0;
+  for (struct atom *cell = atom; is_cons(cell); cell = cdr(cell)) {
+    ++count;
+  }
+
+  struct atom *head = new_list(NULL, count, NULL);
+  struct atom *tail = head;
+  struct atom *result = NULL;
 
-  struct shadow_root *shadow = NULL;
+  // head keeps the cells alive while eval runs (it might trigger GC in TCO)
+  GC_PUSH_FRAME(frame, GC_ROOT(atom), GC_ROOT(head), GC_ROOT(tail));
 
   while (is_cons(atom)) {
-    // Preserve the atom across GC runs (eval might trigger GC in TCO)
-    gc_retain(atom);
-
     struct atom *evaled = eval(car(atom), env);
-
-    gc_release(atom);
-
     if (is_error(evaled)) {
-      return evaled;
+      result = evaled;
+      break;
     }
 
-    struct atom *cons = new_cons(evaled, NULL);
-
-    // retain the generated cons for the duration of eval_list
-    gc_retain(cons);
-    struct shadow_root *new_shadow = malloc(sizeof(struct shadow_root));
-    new_shadow->atom = cons;
-    new_shadow->next = shadow;
-    shadow = new_shadow;
-
-    if (!head) {
-      head = cons;
-      tail = head;
-    } else {
-      tail->value.cons.cdr = cons;
-      tail = cons;
-    }
+    atom_cons(tail)->car = evaled;
+    gc_write_barrier(tail);
+    tail = cdr(tail);
 
     clog_debug(CLOG(LOGGER_EVAL), "eval_list iterating via cdr of atom %p", (void *)atom);
     atom = cdr(atom);
   }
 
-  if (atom && atom->type != ATOM_TYPE_NIL) {
-    return new_atom_error(atom, "expected a list, got something else");
-  }
-
-  if (tail) {
-    tail->value.cons.cdr = atom_nil();
-  } else {
-    head = atom_nil();
-  }
-
-  // release shadow roots now that we have fully evaluated the list
-  struct shadow_root *current = shadow;
-  while (current) {
-    struct shadow_root *next = current->next;
-    gc_release(current->atom);
-    free(current);
-    current = next;
+  if (!result) {
+    if (atom && atom_type_of(atom) != ATOM_TYPE_NIL) {
+      result = new_atom_error(atom, "expected a list, got something else");
+    } else {
+      result = head;
+    }
   }
 
-  return head;
+  GC_POP_FRAME(frame);
+  return result;
 }
 
 struct atom *apply(struct atom *fn, struct atom *args, struct environment *env) {
@@ -184,17 +204,13 @@ struct atom *apply(struct atom *fn, struct atom *args, struct environment *env)
     // Call the internal function - no environment cloning needed
     return fn->value.primitive(args, env);
   } else if (!is_lambda(fn)) {
-    return new_atom_error(fn, "expected a function, got a %s", atom_type_to_string(fn->type));
+    return new_atom_error(fn, "expected a function, got a %s",
+                          atom_type_to_string(atom_type_of(fn)));
   }
 
-  struct environment *parent_env = env;
-  if (fn->type == ATOM_TYPE_LAMBDA) {
-    parent_env = fn->value.lambda.env;
-  }
-
-  env = create_environment(parent_env);
+  env = create_lambda_frame(fn);
 
-  struct atom *error = bind_arguments(env, fn->value.lambda.args, args, 1);
+  struct atom *error = bind_arguments(env, fn->value.lambda.args, args);
   if (error) {
     return error;
   }
@@ -204,20 +220,15 @@ struct atom *apply(struct atom *fn, struct atom *args, struct environment *env)
 
 static struct atom *apply_macro(struct atom *fn, struct atom *args, struct environment *env) {
   if (!is_lambda(fn)) {
-    return new_atom_error(fn, "expected a macro, got a %s", atom_type_to_string(fn->type));
+    return new_atom_error(fn, "expected a macro, got a %s", atom_type_to_string(atom_type_of(fn)));
   } else if ((fn->value.lambda.flags & ATOM_LAMBDA_FLAG_MACRO) == 0) {
     return new_atom_error(fn, "expected a macro, got a function");
   }
 
-  struct environment *parent_env = env;
-  if (fn->type == ATOM_TYPE_LAMBDA) {
-    parent_env = fn->value.lambda.env;
-  }
-
-  env = create_environment(parent_env);
+  env = create_lambda_frame(fn);
 
-  // Bind arguments without evaluating them
-  struct atom *error = bind_arguments(env, fn->value.lambda.args, args, 0);
+  // Macro arguments are bound without being evaluated
+  struct atom *error = bind_arguments(env, fn->value.lambda.args, args);
   if (error) {
     return error;
   }
@@ -227,16 +238,16 @@ static struct atom *apply_macro(struct atom *fn, struct atom *args, struct envir
 }
 
 static struct atom *bind_arguments(struct environment *env, struct atom *binding_list,
-                                   struct atom *args, int should_eval) {
-  clog_debug(CLOG(LOGGER_EVAL), "bind_arguments: binding_list %p args %p should_eval %d\n",
-             (void *)binding_list, (void *)args, should_eval);
+                                   struct atom *args) {
+  clog_debug(CLOG(LOGGER_EVAL), "bind_arguments: binding_list %p args %p\n", (void *)binding_list,
+             (void *)args);
   struct atom *current_arg = args;
-  while (binding_list && binding_list->type == ATOM_TYPE_CONS) {
+  for (size_t slot = 0; binding_list && atom_type_of(binding_list) == ATOM_TYPE_CONS; ++slot) {
     struct atom *param = car(binding_list);
     struct atom *arg = car(current_arg);
 
-    struct atom *evaled = should_eval ? eval(arg, env) : arg;
-    struct atom *bound = env_bind(env, param, evaled);
+    // parameters are bound in order, so the resolver knows each one's slot
+    struct atom *bound = env_bind_slot(env, slot, param, arg);
     if (is_error(bound)) {
       return bound;
     }
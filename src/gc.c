@@ -1,8 +1,15 @@
 #include "gc.h"
 
 #include <clog.h>
+#include <glib-2.0/glib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
 
 #include "atom.h"
 #include "env.h"
@@ -10,26 +17,210 @@
 #include "lex.h"
 #include "log.h"
 
-struct gcnode {
+// Size and alignment of a single slab mapping. Because slabs are aligned to their size, the slab
+// owning any object can be found by masking the object's address. Objects too large to fit a
+// reasonable number of cells into a slab get a dedicated (larger, but equally aligned) mapping.
+#define GC_SLAB_SIZE (64 * 1024)
+#define GC_SLAB_MIN_CELLS 8
+
+#define GC_TYPE_COUNT (GC_TYPE_SYMBOL + 1)
+
+#define GC_BITS_PER_WORD 64
+
+// Initial capacity of the remembered set and the gray worklists.
+#define GC_STACK_INITIAL 256
+
+// Most objects each gray worklist may hold. Past this, objects are still marked but not queued,
+// and are traced by rescanning the heap for marked objects once the worklists drain.
+#define GC_MARK_STACK_MAX (64 * 1024)
+
+// An incremental marking slice is due after allocating this many bytes since the previous one.
+#define GC_STEP_BYTES (16 * 1024)
+
+// Number of objects traced between checks of the clock during an incremental marking slice.
+#define GC_STEP_CHECK_INTERVAL 64
+
+// Number of slabs swept by each call to gc_maybe_run while a lazy sweep is pending.
+#define GC_SWEEP_STEP_SLABS 8
+
+// A compacting collection evacuates slabs that are less than this percentage full.
+#define GC_COMPACT_SPARSE_PERCENT 50
+
+// Lower bounds for the collection budgets, so that a small heap doesn't collect on nearly every
+// safe point. The nursery budget is the number of bytes allocated before a minor collection is
+// due; the heap budget is the size the old generation can reach before a full collection is due.
+#define GC_MIN_NURSERY_BYTES (32 * 1024)
+#define GC_MIN_HEAP_BYTES (1024 * 1024)
+
+#define GC_DEFAULT_PAUSE 200
+#define GC_DEFAULT_MINOR_MUL 20
+#define GC_DEFAULT_MAX_PAUSE 500
+
+// A slab is a single mapping holding fixed-size cells for one size class. There is no per-object
+// header: the object type and size come from the slab, and the allocated/marked state of each
+// cell lives in side-table bitmaps that follow the slab header.
+//
+// Objects are young (in the nursery) from allocation until they survive their first collection,
+// at which point they are promoted to the old generation in place by clearing their young bit.
+struct gcslab {
+  struct gcslab *next;        // next slab in the size class
+  struct gcslab *prev;        // previous slab in the size class
+  struct gcslab *next_sweep;  // next slab in the size class still to be swept
+  struct gcslab *next_free;   // next slab in the size class with free cells
+  struct gcslab *next_young;  // next slab holding young objects
+  int on_free_list;
+  int on_young_list;
+  int evacuating;  // set while a compacting collection moves the slab's objects out
   enum GCType type;
-  size_t size;
-  int marked;
-  struct gcnode *next;
-} __attribute__((aligned(8)));
-
-struct gcroot {
-  struct gcnode *node;
-  struct gcroot *next;
+  size_t cell_size;   // size of each object cell
+  size_t capacity;    // number of cells in the slab
+  size_t bump;        // cells at or beyond this index have never been handed out
+  size_t live;        // number of allocated cells
+  size_t mapped;      // size of the mapping, for munmap
+  size_t words;       // number of words in each bitmap
+  void *free;         // free list of previously swept cells, linked through their first word
+  char *cells;        // first cell in the slab
+  uint64_t *alloc_bits;
+  uint64_t *mark_bits;
+  uint64_t *young_bits;
+  uint64_t *remembered_bits;
+};
+
+// A growable stack of object pointers.
+struct gcstack {
+  void **items;
+  size_t count;
+  size_t capacity;
 };
 
-static struct gcnode *gc_head = NULL;
-static struct gcnode *gc_tail = NULL;
+// One size class per GCType. Every object of a given type has the same size, so the class
+// learns its object size from the first allocation.
+struct gcclass {
+  size_t object_size;
+  struct gcslab *slabs;
+  struct gcslab *free_slabs;  // slabs with at least one free cell
+  struct gcslab *spare;       // one empty slab kept back to avoid map/unmap churn
+  struct gcslab *unswept;     // slabs the last full collection left to sweep lazily
+};
 
-static struct gcroot *roots = NULL;
+struct gcsweep_stats {
+  size_t visited;
+  size_t skipped;
+  size_t swept;
+  size_t total_bytes;
+  size_t remaining_bytes;
+};
 
-static struct gcnode *gc_node(void *ptr) {
-  return (struct gcnode *)ptr - 1;
-}
+static struct gcclass classes[GC_TYPE_COUNT];
+
+// Objects that don't fit their class (e.g. an oversized request) live in a dedicated slab.
+static struct gcslab *large_slabs = NULL;
+
+// Long-lived roots from gc_retain, mapping each retained pointer to its retain count.
+static GHashTable *roots = NULL;
+
+// Innermost active root frame.
+static struct gcframe *frames = NULL;
+
+// Slabs that have handed out cells since the last collection. Minor collections only sweep these.
+static struct gcslab *young_slabs = NULL;
+
+// Old objects that may point at young objects, recorded by the write barrier. These act as extra
+// roots during a minor collection.
+static struct gcstack remset = {NULL, 0, 0};
+
+// Marked objects whose children have not been traced yet (gray, in tri-color terms). Unmarked
+// objects are white and marked objects that are not on a worklist are black. Objects allocated
+// during an incremental collection are kept apart and traced last, so that a busy mutator doesn't
+// keep marking from ever reaching the rest of the heap.
+static struct gcstack gray = {NULL, 0, 0};
+static struct gcstack gray_allocated = {NULL, 0, 0};
+
+// Set when a gray object couldn't be queued because its worklist was full.
+static int mark_overflow = 0;
+
+// A fixed-size Chase-Lev work-stealing deque of gray objects. The owning marker pushes and pops at
+// the bottom; other markers steal from the top. Like the serial worklists, a full deque records a
+// mark overflow rather than growing.
+struct gcdeque {
+  int64_t top;
+  int64_t bottom;
+  void **items;  // GC_MARK_STACK_MAX slots, used as a ring
+};
+
+struct gcworker {
+  pthread_t thread;
+  size_t index;
+  size_t generation;  // last marking round this worker took part in
+  struct gcdeque deque;
+};
+
+// Markers for parallel full collections. Worker 0 is the thread running the collection, and the
+// rest are pool threads that sleep between collections. With a single worker there is no pool.
+static struct gcworker *workers = NULL;
+static size_t worker_count = 1;
+static size_t pool_size = 0;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static size_t pool_generation = 0;  // bumped to start a marking round
+static size_t pool_busy = 0;        // pool threads still marking in this round
+static int pool_stopping = 0;
+
+// Set while the pool is marking, which makes mark bits atomic. idle_markers counts markers that
+// have run out of work; once all of them have, marking is complete.
+static int parallel_marking = 0;
+static size_t idle_markers = 0;
+
+// The marker running on this thread, while marking in parallel.
+static __thread struct gcworker *current_worker = NULL;
+
+// Set while an incremental full collection is between its marking slices. Objects allocated in
+// that time start out gray, and the write barrier re-grays black objects that are stored into, so
+// that no black object ever points at a white one.
+static int incremental = 0;
+static int incremental_marking = 0;
+
+// What had been allocated (see gc_allocated_bytes) as of the previous incremental marking slice,
+// and the heap size when the current incremental collection started.
+static size_t step_allocated_bytes = 0;
+static size_t mark_start_bytes = 0;
+
+static struct gcpause_stats pauses;
+
+// Slabs still to be swept after the last full collection, across all classes, and what sweeping
+// them has freed so far.
+static size_t unswept_slabs = 0;
+static struct gcsweep_stats lazy_stats;
+
+// Set while a minor collection is marking. Old objects are treated as already marked so marking
+// stops at the generation boundary.
+static int minor_collection = 0;
+
+// Bytes promoted by minor collections since the last full collection, and the number of live bytes
+// the last full collection left behind.
+static size_t promoted_bytes = 0;
+static size_t old_bytes = 0;
+
+// Bytes allocated since the last collection of any kind.
+static size_t allocated_bytes = 0;
+
+// Bytes owned by GC objects outside the GC heap (see gc_note_external), and how many of them were
+// allocated since the last collection of any kind. They count towards the heap size and what's
+// been allocated, but aren't part of old_bytes or promoted_bytes.
+static size_t external_bytes = 0;
+static size_t external_allocated_bytes = 0;
+
+// Collection budgets, recomputed from the tunables after every collection.
+static size_t nursery_budget = GC_MIN_NURSERY_BYTES;
+static size_t heap_budget = GC_MIN_HEAP_BYTES;
+
+static int params[GC_PARAM_COUNT] = {
+    [GC_PARAM_PAUSE] = GC_DEFAULT_PAUSE,
+    [GC_PARAM_MINOR_MUL] = GC_DEFAULT_MINOR_MUL,
+    [GC_PARAM_MAX_PAUSE] = GC_DEFAULT_MAX_PAUSE,
+};
 
 static const char *gc_type_to_str(enum GCType type) {
   switch (type) {
@@ -43,71 +234,448 @@ static const char *gc_type_to_str(enum GCType type) {
       return "binding_cell";
     case GC_TYPE_LEXER:
       return "lexer";
+    case GC_TYPE_CONS:
+      return "cons";
+    case GC_TYPE_SYMBOL:
+      return "symbol";
   }
 
   return "unknown";
 }
 
-void *gc_new(enum GCType type, size_t size) {
-  struct gcnode *node = malloc(sizeof(struct gcnode) + size);
-  if (!node) {
-    fprintf(stderr, "Error: could not allocate memory for GC node\n");
+static size_t gc_align(size_t size, size_t alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static struct gcslab *gc_slab_of(void *ptr) {
+  return (struct gcslab *)((uintptr_t)ptr & ~(uintptr_t)(GC_SLAB_SIZE - 1));
+}
+
+static size_t gc_slab_index(struct gcslab *slab, void *ptr) {
+  return (size_t)((char *)ptr - slab->cells) / slab->cell_size;
+}
+
+static void *gc_slab_cell(struct gcslab *slab, size_t index) {
+  return slab->cells + (index * slab->cell_size);
+}
+
+static size_t gc_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((size_t)ts.tv_sec * 1000000) + ((size_t)ts.tv_nsec / 1000);
+}
+
+// Records a collection pause that started at the given time in the pause histogram.
+static void gc_record_pause(size_t start_us) {
+  size_t elapsed = gc_now_us() - start_us;
+
+  size_t bucket = 0;
+  while (bucket < GC_PAUSE_BUCKETS - 1 && elapsed >= ((size_t)1 << bucket)) {
+    ++bucket;
+  }
+
+  ++pauses.buckets[bucket];
+  ++pauses.count;
+  pauses.total_us += elapsed;
+  if (elapsed > pauses.max_us) {
+    pauses.max_us = elapsed;
+  }
+}
+
+static int gc_test_bit(uint64_t *bits, size_t index) {
+  return (bits[index / GC_BITS_PER_WORD] & ((uint64_t)1 << (index % GC_BITS_PER_WORD))) != 0;
+}
+
+static void gc_set_bit(uint64_t *bits, size_t index) {
+  bits[index / GC_BITS_PER_WORD] |= (uint64_t)1 << (index % GC_BITS_PER_WORD);
+}
+
+// Maps size bytes aligned to GC_SLAB_SIZE by over-mapping and trimming the excess.
+static void *gc_map_aligned(size_t size) {
+  size_t padded = size + GC_SLAB_SIZE;
+  char *mem = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return NULL;
+  }
+
+  char *aligned = (char *)gc_align((uintptr_t)mem, GC_SLAB_SIZE);
+  if (aligned > mem) {
+    munmap(mem, aligned - mem);
+  }
+
+  size_t tail = (mem + padded) - (aligned + size);
+  if (tail) {
+    munmap(aligned + size, tail);
+  }
+
+  return aligned;
+}
+
+static struct gcslab *gc_slab_new(enum GCType type, size_t object_size, int dedicated) {
+  size_t cell_size = gc_align(object_size, 8);
+
+  size_t mapped = GC_SLAB_SIZE;
+  size_t capacity = (GC_SLAB_SIZE - sizeof(struct gcslab)) / cell_size;
+  if (dedicated || capacity < GC_SLAB_MIN_CELLS) {
+    // Too big for a shared slab, give it a mapping of its own.
+    capacity = 1;
+  }
+
+  size_t words = (capacity + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+  size_t header = gc_align(sizeof(struct gcslab) + (4 * words * sizeof(uint64_t)), 16);
+
+  // Bitmaps eat into the cell area, so shrink until everything fits.
+  while (capacity > 1 && header + (capacity * cell_size) > GC_SLAB_SIZE) {
+    --capacity;
+  }
+
+  if (capacity == 1) {
+    mapped = gc_align(header + cell_size, GC_SLAB_SIZE);
+  }
+
+  void *mem = gc_map_aligned(mapped);
+  if (!mem) {
+    fprintf(stderr, "Error: could not map memory for GC slab\n");
+    return NULL;
+  }
+
+  struct gcslab *slab = (struct gcslab *)mem;
+  slab->next = NULL;
+  slab->prev = NULL;
+  slab->next_sweep = NULL;
+  slab->next_free = NULL;
+  slab->next_young = NULL;
+  slab->on_free_list = 0;
+  slab->on_young_list = 0;
+  slab->evacuating = 0;
+  slab->type = type;
+  slab->cell_size = cell_size;
+  slab->capacity = capacity;
+  slab->bump = 0;
+  slab->live = 0;
+  slab->mapped = mapped;
+  slab->words = words;
+  slab->free = NULL;
+  slab->cells = (char *)mem + header;
+  slab->alloc_bits = (uint64_t *)(slab + 1);
+  slab->mark_bits = slab->alloc_bits + words;
+  slab->young_bits = slab->mark_bits + words;
+  slab->remembered_bits = slab->young_bits + words;
+
+  // Fresh anonymous mappings are zeroed, so the bitmaps start out clear.
+
+  clog_debug(CLOG(LOGGER_GC), "GC: mapped slab %p with %zu cells of %zu bytes", (void *)slab,
+             slab->capacity, cell_size);
+
+  return slab;
+}
+
+static void gc_slab_free(struct gcslab *slab) {
+  clog_debug(CLOG(LOGGER_GC), "GC: unmapping slab %p", (void *)slab);
+  munmap(slab, slab->mapped);
+}
+
+static void gc_stack_push(struct gcstack *stack, void *ptr) {
+  if (stack->count == stack->capacity) {
+    stack->capacity = stack->capacity ? stack->capacity * 2 : GC_STACK_INITIAL;
+    stack->items = realloc(stack->items, stack->capacity * sizeof(void *));
+  }
+
+  stack->items[stack->count++] = ptr;
+}
+
+// Queues a gray object, or records an overflow if its worklist is full.
+static void gc_gray_push(struct gcstack *stack, void *ptr) {
+  if (stack->count == GC_MARK_STACK_MAX) {
+    mark_overflow = 1;
+    return;
+  }
+
+  gc_stack_push(stack, ptr);
+}
+
+static void gc_deque_push(struct gcdeque *deque, void *ptr) {
+  int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+  int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+  if (bottom - top >= GC_MARK_STACK_MAX) {
+    __atomic_store_n(&mark_overflow, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  __atomic_store_n(&deque->items[bottom % GC_MARK_STACK_MAX], ptr, __ATOMIC_RELAXED);
+  __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+}
+
+static void *gc_deque_pop(struct gcdeque *deque) {
+  int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+  if (top > bottom) {
+    // Empty.
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+
+  void *ptr = __atomic_load_n(&deque->items[bottom % GC_MARK_STACK_MAX], __ATOMIC_RELAXED);
+  if (top == bottom) {
+    // Last item, which a thief may be taking at the same time.
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0, __ATOMIC_SEQ_CST,
+                                     __ATOMIC_RELAXED)) {
+      ptr = NULL;
+    }
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+  }
+
+  return ptr;
+}
+
+static void *gc_deque_steal(struct gcdeque *deque) {
+  int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+  if (top >= bottom) {
+    return NULL;
+  }
+
+  void *ptr = __atomic_load_n(&deque->items[top % GC_MARK_STACK_MAX], __ATOMIC_RELAXED);
+  if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0, __ATOMIC_SEQ_CST,
+                                   __ATOMIC_RELAXED)) {
+    // Lost a race with the owner or another thief.
+    return NULL;
+  }
+
+  return ptr;
+}
+
+static int gc_deque_empty(struct gcdeque *deque) {
+  return __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE) >=
+         __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+}
+
+static void gc_stack_free(struct gcstack *stack) {
+  free(stack->items);
+  stack->items = NULL;
+  stack->count = 0;
+  stack->capacity = 0;
+}
+
+// Takes a free cell from a slab and marks it allocated, or returns NULL if the slab is full.
+static void *gc_slab_take(struct gcslab *slab) {
+  void *cell = NULL;
+  if (slab->free) {
+    cell = slab->free;
+    slab->free = *(void **)cell;
+  } else if (slab->bump < slab->capacity) {
+    cell = gc_slab_cell(slab, slab->bump++);
+  } else {
+    return NULL;
+  }
+
+  gc_set_bit(slab->alloc_bits, gc_slab_index(slab, cell));
+  ++slab->live;
+  return cell;
+}
+
+static void *gc_slab_alloc(struct gcslab *slab) {
+  void *cell = gc_slab_take(slab);
+  if (!cell) {
     return NULL;
   }
 
-  node->type = type;
-  node->size = size;
-  node->marked = 0;
-  node->next = NULL;
+  size_t index = gc_slab_index(slab, cell);
+  gc_set_bit(slab->young_bits, index);
+
+  if (incremental_marking) {
+    // Allocate gray: the new object can't be traced until it's initialized, but it is only traced
+    // in a later marking slice, by which point it will be.
+    gc_set_bit(slab->mark_bits, index);
+    gc_gray_push(&gray_allocated, cell);
+  }
+
+  if (!slab->on_young_list) {
+    slab->on_young_list = 1;
+    slab->next_young = young_slabs;
+    young_slabs = slab;
+  }
+
+  allocated_bytes += slab->cell_size;
+  return cell;
+}
+
+// The heap size the heap budget is compared to.
+static size_t gc_heap_bytes(void) {
+  return old_bytes + promoted_bytes + allocated_bytes + external_bytes;
+}
+
+// What's been allocated since the last collection, which the nursery budget is compared to.
+static size_t gc_allocated_bytes(void) {
+  return allocated_bytes + external_allocated_bytes;
+}
+
+void gc_note_external(size_t size) {
+  external_bytes += size;
+  external_allocated_bytes += size;
+}
+
+void gc_forget_external(size_t size) {
+  external_bytes = size < external_bytes ? external_bytes - size : 0;
+}
+
+static void gc_class_sweep_next(struct gcclass *cls, struct gcsweep_stats *stats);
+
+static struct gcslab *gc_class_slab(enum GCType type) {
+  struct gcclass *cls = &classes[type];
+
+  // Drop slabs that filled up since they were put on the free slab list.
+  while (cls->free_slabs && cls->free_slabs->live == cls->free_slabs->capacity) {
+    cls->free_slabs->on_free_list = 0;
+    cls->free_slabs = cls->free_slabs->next_free;
+  }
+
+  // Sweep slabs left over from the last full collection until one has room.
+  while (!cls->free_slabs && cls->unswept) {
+    gc_class_sweep_next(cls, &lazy_stats);
+  }
+
+  if (cls->free_slabs) {
+    return cls->free_slabs;
+  }
+
+  struct gcslab *slab = cls->spare;
+  if (slab) {
+    cls->spare = NULL;
+  } else {
+    slab = gc_slab_new(type, cls->object_size, 0);
+    if (!slab) {
+      return NULL;
+    }
+  }
+
+  slab->prev = NULL;
+  slab->next = cls->slabs;
+  if (cls->slabs) {
+    cls->slabs->prev = slab;
+  }
+  cls->slabs = slab;
+
+  slab->next_free = NULL;
+  slab->on_free_list = 1;
+  cls->free_slabs = slab;
+
+  return slab;
+}
+
+void *gc_new(enum GCType type, size_t size) {
+  struct gcclass *cls = &classes[type];
+  if (!cls->object_size) {
+    cls->object_size = gc_align(size, 8);
+  }
 
-  if (!gc_head) {
-    gc_head = node;
-    gc_tail = node;
+  void *ptr = NULL;
+  if (size <= cls->object_size) {
+    struct gcslab *slab = gc_class_slab(type);
+    if (slab) {
+      ptr = gc_slab_alloc(slab);
+    }
   } else {
-    gc_tail->next = node;
-    gc_tail = node;
+    struct gcslab *slab = gc_slab_new(type, size, 1);
+    if (slab) {
+      ptr = gc_slab_alloc(slab);
+      slab->next = large_slabs;
+      large_slabs = slab;
+    }
+  }
+
+  if (!ptr) {
+    fprintf(stderr, "Error: could not allocate memory for GC node\n");
+    return NULL;
   }
 
-  return (void *)(node + 1);  // Return pointer to the memory after the gcnode
+  return ptr;
+}
+
+enum GCType gc_type_of(void *ptr) {
+  return gc_slab_of(ptr)->type;
 }
 
 void gc_retain(void *ptr) {
-  struct gcnode *node = gc_node(ptr);
+  // Fixnums and the static atoms live outside the heap and need no retaining.
+  if (is_static_atom((struct atom *)ptr)) {
+    return;
+  }
 
-  clog_debug(CLOG(LOGGER_GC), "GC: retaining %p (actual %p) of type %s", (void *)node,
-             (void *)(node + 1), gc_type_to_str(node->type));
+  clog_debug(CLOG(LOGGER_GC), "GC: retaining %p of type %s", ptr,
+             gc_type_to_str(gc_slab_of(ptr)->type));
+
+  if (!roots) {
+    roots = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
 
-  struct gcroot *new_root = malloc(sizeof(struct gcroot));
-  new_root->node = node;
-  new_root->next = roots;
-  roots = new_root;
+  guint count = GPOINTER_TO_UINT(g_hash_table_lookup(roots, ptr));
+  g_hash_table_insert(roots, ptr, GUINT_TO_POINTER(count + 1));
 }
 
 void gc_release(void *ptr) {
-  struct gcnode *node = gc_node(ptr);
+  if (is_static_atom((struct atom *)ptr)) {
+    return;
+  }
 
-  clog_debug(CLOG(LOGGER_GC), "GC: removing root %p (actual %p) of type %s", (void *)node,
-             (void *)(node + 1), gc_type_to_str(node->type));
+  clog_debug(CLOG(LOGGER_GC), "GC: removing root %p of type %s", ptr,
+             gc_type_to_str(gc_slab_of(ptr)->type));
 
-  // Find and remove the root
-  struct gcroot *curr = roots;
-  struct gcroot *prev = NULL;
-  while (curr) {
-    if (curr->node == node) {
-      if (prev) {
-        prev->next = curr->next;
-      } else {
-        roots = curr->next;
-      }
-      free(curr);
-      return;
-    }
+  guint count = roots ? GPOINTER_TO_UINT(g_hash_table_lookup(roots, ptr)) : 0;
+  if (!count) {
+    fprintf(stderr, "Warning: gc_release called on a pointer not retained by GC\n");
+    return;
+  }
+
+  if (count == 1) {
+    g_hash_table_remove(roots, ptr);
+  } else {
+    g_hash_table_insert(roots, ptr, GUINT_TO_POINTER(count - 1));
+  }
+}
+
+void gc_push_frame(struct gcframe *frame) {
+  frame->prev = frames;
+  frames = frame;
+}
+
+void gc_pop_frame(struct gcframe *frame) {
+  if (frames != frame) {
+    fprintf(stderr, "Warning: gc_pop_frame called out of order\n");
+  }
+
+  frames = frame->prev;
+}
 
-    prev = curr;
-    curr = curr->next;
+// Sets the object's mark bit, returning 1 if it was already set.
+static int gc_test_and_set_mark(void *ptr) {
+  struct gcslab *slab = gc_slab_of(ptr);
+  size_t index = gc_slab_index(slab, ptr);
+
+  if (minor_collection && !gc_test_bit(slab->young_bits, index)) {
+    // Old objects are live for the purposes of a minor collection; anything young they point to
+    // is reached through the remembered set instead.
+    return 1;
+  }
+
+  uint64_t *word = &slab->mark_bits[index / GC_BITS_PER_WORD];
+  uint64_t bit = (uint64_t)1 << (index % GC_BITS_PER_WORD);
+
+  if (parallel_marking) {
+    // Other markers may be setting bits in the same word.
+    return (__atomic_fetch_or(word, bit, __ATOMIC_RELAXED) & bit) != 0;
   }
 
-  fprintf(stderr, "Warning: gc_release called on a pointer not retained by GC\n");
+  if (*word & bit) {
+    return 1;
+  }
+
+  *word |= bit;
+  return 0;
 }
 
 int gc_mark(void *ptr) {
@@ -115,142 +683,1248 @@ int gc_mark(void *ptr) {
     return 0;
   }
 
-  struct gcnode *node = gc_node(ptr);
-  int marked = node->marked;
-  node->marked = 1;
-  return marked;
+  if (gc_test_and_set_mark(ptr)) {
+    return 1;
+  }
+
+  if (current_worker) {
+    gc_deque_push(&current_worker->deque, ptr);
+  } else {
+    gc_gray_push(&gray, ptr);
+  }
+  return 0;
+}
+
+int gc_set_mark(void *ptr) {
+  return gc_test_and_set_mark(ptr);
+}
+
+void gc_write_barrier(void *owner) {
+  struct gcslab *slab = gc_slab_of(owner);
+  size_t index = gc_slab_index(slab, owner);
+
+  if (incremental_marking && gc_test_bit(slab->mark_bits, index)) {
+    // The owner may already be black, and whatever was just stored into it may still be white.
+    gc_gray_push(&gray, owner);
+  }
+
+  if (gc_test_bit(slab->young_bits, index) || gc_test_bit(slab->remembered_bits, index)) {
+    return;
+  }
+
+  gc_set_bit(slab->remembered_bits, index);
+
+  gc_stack_push(&remset, owner);
+}
+
+static void gc_remset_clear(void) {
+  for (size_t i = 0; i < remset.count; ++i) {
+    struct gcslab *slab = gc_slab_of(remset.items[i]);
+    size_t index = gc_slab_index(slab, remset.items[i]);
+    slab->remembered_bits[index / GC_BITS_PER_WORD] &=
+        ~((uint64_t)1 << (index % GC_BITS_PER_WORD));
+  }
+
+  remset.count = 0;
 }
 
 void gc_init(void) {
-  gc_head = NULL;
-  gc_tail = NULL;
+  for (size_t i = 0; i < GC_TYPE_COUNT; ++i) {
+    classes[i].object_size = 0;
+    classes[i].slabs = NULL;
+    classes[i].free_slabs = NULL;
+    classes[i].spare = NULL;
+    classes[i].unswept = NULL;
+  }
+
+  large_slabs = NULL;
+  young_slabs = NULL;
+  unswept_slabs = 0;
+
+  remset.count = 0;
+  gray.count = 0;
+  gray_allocated.count = 0;
+  mark_overflow = 0;
+  incremental_marking = 0;
+  pauses = (struct gcpause_stats){0, 0, 0, {0}};
+  promoted_bytes = 0;
+  old_bytes = 0;
+  allocated_bytes = 0;
+  external_bytes = 0;
+  external_allocated_bytes = 0;
+  nursery_budget = GC_MIN_NURSERY_BYTES;
+  heap_budget = GC_MIN_HEAP_BYTES;
 }
 
-size_t gc_run(void) {
-  // Mark phase
-  for (struct gcroot *root = roots; root; root = root->next) {
-    struct gcnode *node = root->node;
-    if (node) {
-      switch (node->type) {
-        case GC_TYPE_ATOM: {
-          struct atom *atom = (struct atom *)(node + 1);
-
-          // mark atom and its reachable parts
-          atom_mark(atom);
-        } break;
-        case GC_TYPE_ENVIRONMENT: {
-          struct environment *env = (struct environment *)(node + 1);
-
-          environment_gc_mark(env);
-        } break;
-        case GC_TYPE_BINDING_CELL: {
-          // Should already be marked by environment marking.
-          node->marked = 1;
-        } break;
-        case GC_TYPE_TOKEN: {
-          node->marked = 1;
-        } break;
-        case GC_TYPE_LEXER: {
-          struct lex *lexer = (struct lex *)(node + 1);
-          lex_gc_mark(lexer);
-        } break;
-      }
-    }
+// Recomputes the collection budgets from the live heap size after a collection.
+static void gc_update_budgets(void) {
+  size_t live = old_bytes + promoted_bytes + external_bytes;
+
+  nursery_budget = (old_bytes / 100) * (size_t)params[GC_PARAM_MINOR_MUL];
+  if (nursery_budget < GC_MIN_NURSERY_BYTES) {
+    nursery_budget = GC_MIN_NURSERY_BYTES;
   }
 
-  intern_gc_mark();
+  heap_budget = (live / 100) * (size_t)params[GC_PARAM_PAUSE];
+  if (heap_budget < GC_MIN_HEAP_BYTES) {
+    heap_budget = GC_MIN_HEAP_BYTES;
+  }
+}
+
+static void gc_erase(enum GCType type, void *ptr) {
+  // Erase primitives inside the data type
+  switch (type) {
+    case GC_TYPE_ATOM:
+    case GC_TYPE_SYMBOL: {
+      erase_atom((struct atom *)ptr);
+    } break;
+    case GC_TYPE_ENVIRONMENT: {
+      erase_environment((struct environment *)ptr);
+    } break;
+    case GC_TYPE_BINDING_CELL:
+    case GC_TYPE_CONS: {
+      // Nothing within a binding cell or a cons cell needs to be erased.
+    } break;
+    case GC_TYPE_TOKEN: {
+      lex_gc_erase_token((struct token *)ptr);
+    } break;
+    case GC_TYPE_LEXER: {
+      lex_gc_erase((struct lex *)ptr);
+    } break;
+  }
 
-  size_t total_visited = 0;
-  size_t total_skipped = 0;
-  size_t total_swept = 0;
+  clog_debug(CLOG(LOGGER_GC), "GC: collected %p of type %s", ptr, gc_type_to_str(type));
+}
 
-  size_t total_bytes = 0;
-  size_t remaining_bytes = 0;
+// Sweeps a single slab a bitmap word at a time, returning dead cells to its free list. Words
+// with no allocated-but-unmarked cells are skipped without touching the cells themselves. The slab
+// is swept from the end, so that the free list hands cells out in address order and objects
+// allocated one after the other (e.g. the cells of a list) end up next to each other.
+static void gc_sweep_slab(struct gcslab *slab, struct gcsweep_stats *stats) {
+  size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+  for (size_t w = words; w-- > 0;) {
+    uint64_t alloc = slab->alloc_bits[w];
+    uint64_t marked = slab->mark_bits[w];
+    uint64_t dead = alloc & ~marked;
 
-  // Sweep phase
-  struct gcnode *node = gc_head;
-  struct gcnode *prev = NULL;
-  while (node) {
-    int marked = node->marked;
-    node->marked = 0;
-
-    ++total_visited;
-    total_bytes += node->size;
-
-    if (marked) {
-      ++total_skipped;
-      remaining_bytes += node->size;
-
-      // Safe.
-      prev = node;
-      node = node->next;
-      continue;
+    size_t live = (size_t)__builtin_popcountll(alloc & marked);
+    stats->visited += live;
+    stats->skipped += live;
+    stats->total_bytes += live * slab->cell_size;
+    stats->remaining_bytes += live * slab->cell_size;
+
+    slab->alloc_bits[w] = alloc & marked;
+    slab->mark_bits[w] = 0;
+
+    while (dead) {
+      size_t bit = GC_BITS_PER_WORD - 1 - (size_t)__builtin_clzll(dead);
+      size_t index = (w * GC_BITS_PER_WORD) + bit;
+      dead &= ~((uint64_t)1 << bit);
+
+      void *cell = gc_slab_cell(slab, index);
+
+      ++stats->visited;
+      ++stats->swept;
+      stats->total_bytes += slab->cell_size;
+
+      // Not marked, so it's available for collection.
+      gc_erase(slab->type, cell);
+
+      *(void **)cell = slab->free;
+      slab->free = cell;
+      --slab->live;
     }
+  }
+}
+
+// Counts the allocated and marked cells of a slab left to sweep lazily, without touching the cells.
+static void gc_count_slab(struct gcslab *slab, struct gcsweep_stats *stats) {
+  size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+  for (size_t w = 0; w < words; ++w) {
+    size_t allocated = (size_t)__builtin_popcountll(slab->alloc_bits[w]);
+    size_t live = (size_t)__builtin_popcountll(slab->alloc_bits[w] & slab->mark_bits[w]);
+    stats->total_bytes += allocated * slab->cell_size;
+    stats->remaining_bytes += live * slab->cell_size;
+  }
+}
 
-    ++total_swept;
+// Sweeps a slab in a size class and files it according to what's left. An empty slab is kept as
+// the class's spare, or given back to the OS if there already is one, and a slab with room goes on
+// the free slab list.
+static void gc_class_sweep_slab(struct gcclass *cls, struct gcslab *slab,
+                                struct gcsweep_stats *stats) {
+  gc_sweep_slab(slab, stats);
 
-    // Not marked, so it's available for collection.
-    if (prev) {
-      prev->next = node->next;
+  if (slab->live == 0) {
+    if (slab->prev) {
+      slab->prev->next = slab->next;
     } else {
-      gc_head = node->next;
+      cls->slabs = slab->next;
     }
-
-    if (node == gc_tail) {
-      gc_tail = prev;
+    if (slab->next) {
+      slab->next->prev = slab->prev;
     }
 
-    // Erase primitives inside the data type
-    switch (node->type) {
-      case GC_TYPE_ATOM: {
-        struct atom *atom = (struct atom *)(node + 1);
-        erase_atom(atom);
-      } break;
-      case GC_TYPE_ENVIRONMENT: {
-        struct environment *env = (struct environment *)(node + 1);
-        erase_environment(env);
-      } break;
-      case GC_TYPE_BINDING_CELL: {
-        // Nothing within a binding cell needs to be erased.
-      } break;
-      case GC_TYPE_TOKEN: {
-        lex_gc_erase_token((struct token *)(node + 1));
-      } break;
-      case GC_TYPE_LEXER: {
-        lex_gc_erase((struct lex *)(node + 1));
-      } break;
+    if (!cls->spare) {
+      slab->next = NULL;
+      slab->prev = NULL;
+      slab->free = NULL;
+      slab->bump = 0;
+      cls->spare = slab;
+    } else {
+      gc_slab_free(slab);
     }
+  } else if (slab->live < slab->capacity && !slab->on_free_list) {
+    slab->next_free = cls->free_slabs;
+    slab->on_free_list = 1;
+    cls->free_slabs = slab;
+  }
+}
 
-    struct gcnode *next = node->next;
+// Lazily sweeps the next slab left over from the last full collection in a size class. Dead
+// objects are only finalized (e.g. their strings freed) at this point, a slab at a time.
+static void gc_class_sweep_next(struct gcclass *cls, struct gcsweep_stats *stats) {
+  struct gcslab *slab = cls->unswept;
+  cls->unswept = slab->next_sweep;
+  slab->next_sweep = NULL;
 
-    clog_debug(CLOG(LOGGER_GC), "GC: collected %p (actual %p) of type %s", (void *)node,
-               (void *)(node + 1), gc_type_to_str(node->type));
-    free(node);
+  gc_class_sweep_slab(cls, slab, stats);
 
-    node = next;
+  if (--unswept_slabs == 0) {
+    clog_debug(CLOG(LOGGER_GC), "GC: lazy sweep finished, swept %zu, freed %zu bytes",
+               lazy_stats.swept, lazy_stats.total_bytes - lazy_stats.remaining_bytes);
+
+    // Only now have the dead objects given back their external memory, so the budgets the
+    // collection set counted it as live.
+    gc_update_budgets();
   }
+}
 
-  clog_debug(CLOG(LOGGER_GC), "GC: visited %zu nodes, skipped %zu, swept %zu", total_visited,
-             total_skipped, total_swept);
-  clog_info(CLOG(LOGGER_GC),
-            "GC: started with %zu total bytes allocated, retained %zu bytes, freed %zu bytes",
-            total_bytes, remaining_bytes, total_bytes - remaining_bytes);
+// Sweeps up to max_slabs slabs left over from the last full collection, returning the number of
+// bytes freed.
+static size_t gc_sweep_step(size_t max_slabs) {
+  struct gcsweep_stats stats = {0, 0, 0, 0, 0};
+  for (size_t i = 0; i < GC_TYPE_COUNT && max_slabs; ++i) {
+    while (classes[i].unswept && max_slabs) {
+      gc_class_sweep_next(&classes[i], &stats);
+      --max_slabs;
+    }
+  }
 
-  return total_bytes - remaining_bytes;
+  return stats.total_bytes - stats.remaining_bytes;
 }
 
-void gc_shutdown(void) {
-  if (gc_head != NULL) {
-    fprintf(stderr, "Warning: GC shutdown called with uncollected nodes\n");
+// Finishes any lazy sweep left over from the last full collection. Mark bits in unswept slabs are
+// still those of that collection, so this must happen before marking again.
+static void gc_sweep_pending(void) {
+  if (unswept_slabs) {
+    gc_sweep_step(unswept_slabs);
+  }
+}
+
+// Marks the children of an object, which queues any that weren't already marked for tracing.
+static void gc_mark_children(void *ptr) {
+  switch (gc_slab_of(ptr)->type) {
+    case GC_TYPE_ATOM:
+    case GC_TYPE_CONS:
+    case GC_TYPE_SYMBOL:
+      atom_mark_children((struct atom *)ptr);
+      break;
+    case GC_TYPE_ENVIRONMENT:
+      environment_gc_mark_children((struct environment *)ptr);
+      break;
+    case GC_TYPE_BINDING_CELL:
+      binding_cell_gc_mark_children(ptr);
+      break;
+    case GC_TYPE_TOKEN:
+      break;
+    case GC_TYPE_LEXER:
+      lex_gc_mark_children((struct lex *)ptr);
+      break;
+  }
+}
+
+// Traces gray objects until there are none left, or until the deadline (if any) passes. Returns
+// 1 once the worklists are empty.
+static int gc_mark_trace(size_t deadline_us) {
+  size_t traced = 0;
+  while (gray.count || gray_allocated.count) {
+    if (gray.count) {
+      gc_mark_children(gray.items[--gray.count]);
+    } else {
+      gc_mark_children(gray_allocated.items[--gray_allocated.count]);
+    }
+
+    if (deadline_us && ++traced % GC_STEP_CHECK_INTERVAL == 0 && gc_now_us() >= deadline_us) {
+      return gray.count == 0 && gray_allocated.count == 0;
+    }
+  }
+
+  return 1;
+}
+
+// Traces the children of every marked object in the slab, draining the worklists as it goes.
+static void gc_mark_rescan_slab(struct gcslab *slab) {
+  size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+  for (size_t w = 0; w < words; ++w) {
+    uint64_t marked = slab->alloc_bits[w] & slab->mark_bits[w];
+    while (marked) {
+      size_t index = (w * GC_BITS_PER_WORD) + (size_t)__builtin_ctzll(marked);
+      marked &= marked - 1;
+
+      gc_mark_children(gc_slab_cell(slab, index));
+      gc_mark_trace(0);
+    }
+  }
+}
+
+// Recovers from a mark stack overflow. Some marked objects were never queued, so their children
+// may still be unmarked; tracing every marked object again finds them. A minor collection only
+// marks young objects, so only slabs holding young objects need rescanning.
+static void gc_mark_rescan(void) {
+  clog_debug(CLOG(LOGGER_GC), "GC: mark stack overflowed, rescanning marked objects");
+
+  mark_overflow = 0;
+
+  if (minor_collection) {
+    for (struct gcslab *slab = young_slabs; slab; slab = slab->next_young) {
+      gc_mark_rescan_slab(slab);
+    }
+    return;
+  }
+
+  for (size_t i = 0; i < GC_TYPE_COUNT; ++i) {
+    for (struct gcslab *slab = classes[i].slabs; slab; slab = slab->next) {
+      gc_mark_rescan_slab(slab);
+    }
+  }
+
+  for (struct gcslab *slab = large_slabs; slab; slab = slab->next) {
+    gc_mark_rescan_slab(slab);
+  }
+}
+
+// Traces gray objects until marking is complete, or until the deadline (if any) passes. Returns 1
+// once marking is complete.
+static int gc_mark_drain(size_t deadline_us) {
+  while (1) {
+    if (!gc_mark_trace(deadline_us)) {
+      return 0;
+    }
+
+    if (!mark_overflow) {
+      return 1;
+    }
+
+    // Worklists are empty, but objects were dropped from them along the way.
+    gc_mark_rescan();
+  }
+}
+
+// Marks from this worker's deque until no marker has any work left, stealing when it runs dry.
+static void gc_parallel_mark(struct gcworker *self) {
+  current_worker = self;
+
+  while (1) {
+    void *ptr;
+    while ((ptr = gc_deque_pop(&self->deque))) {
+      gc_mark_children(ptr);
+    }
+
+    for (size_t i = 1; i < worker_count && !ptr; ++i) {
+      ptr = gc_deque_steal(&workers[(self->index + i) % worker_count].deque);
+    }
+
+    if (ptr) {
+      gc_mark_children(ptr);
+      continue;
+    }
+
+    // Out of work. Idle markers never push, so once every marker is idle all deques are empty.
+    __atomic_add_fetch(&idle_markers, 1, __ATOMIC_SEQ_CST);
+    int done = 0;
+    while (!done) {
+      if (__atomic_load_n(&idle_markers, __ATOMIC_SEQ_CST) == worker_count) {
+        done = 1;
+        break;
+      }
+
+      int found = 0;
+      for (size_t i = 0; i < worker_count && !found; ++i) {
+        found = !gc_deque_empty(&workers[i].deque);
+      }
+
+      if (found) {
+        __atomic_sub_fetch(&idle_markers, 1, __ATOMIC_SEQ_CST);
+        break;
+      }
+
+      sched_yield();
+    }
+
+    if (done) {
+      break;
+    }
+  }
+
+  current_worker = NULL;
+}
+
+static void *gc_worker_main(void *arg) {
+  struct gcworker *self = (struct gcworker *)arg;
+
+  pthread_mutex_lock(&pool_lock);
+  while (1) {
+    while (!pool_stopping && self->generation == pool_generation) {
+      pthread_cond_wait(&pool_start, &pool_lock);
+    }
+
+    if (pool_stopping) {
+      break;
+    }
+
+    self->generation = pool_generation;
+    pthread_mutex_unlock(&pool_lock);
+
+    gc_parallel_mark(self);
+
+    pthread_mutex_lock(&pool_lock);
+    if (--pool_busy == 0) {
+      pthread_cond_signal(&pool_done);
+    }
+  }
+  pthread_mutex_unlock(&pool_lock);
+
+  return NULL;
+}
+
+// Stops the pool threads and frees the workers. Only the first worker_count workers have threads
+// running, but all pool_size workers are freed.
+static void gc_pool_stop(void) {
+  if (!workers) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool_lock);
+  pool_stopping = 1;
+  pthread_cond_broadcast(&pool_start);
+  pthread_mutex_unlock(&pool_lock);
+
+  for (size_t i = 1; i < worker_count; ++i) {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  for (size_t i = 0; i < pool_size; ++i) {
+    free(workers[i].deque.items);
+  }
+
+  free(workers);
+  workers = NULL;
+  worker_count = 1;
+  pool_size = 0;
+  pool_stopping = 0;
+}
+
+static int gc_pool_start(size_t count) {
+  workers = calloc(count, sizeof(struct gcworker));
+  if (!workers) {
+    return -1;
+  }
+
+  pool_size = count;
+  worker_count = 1;
+
+  for (size_t i = 0; i < count; ++i) {
+    workers[i].index = i;
+    workers[i].generation = pool_generation;
+    workers[i].deque.items = malloc(GC_MARK_STACK_MAX * sizeof(void *));
+    if (!workers[i].deque.items) {
+      gc_pool_stop();
+      return -1;
+    }
+  }
+
+  for (size_t i = 1; i < count; ++i) {
+    if (pthread_create(&workers[i].thread, NULL, gc_worker_main, &workers[i]) != 0) {
+      gc_pool_stop();
+      return -1;
+    }
+
+    worker_count = i + 1;
+  }
+
+  return 0;
+}
+
+// Marks everything reachable from the gray worklists using every worker. Anything the deques
+// couldn't hold is left for the serial overflow rescan.
+static void gc_mark_parallel(void) {
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers[i].deque.top = 0;
+    workers[i].deque.bottom = 0;
+  }
+
+  size_t next = 0;
+  while (gray.count) {
+    gc_deque_push(&workers[next++ % worker_count].deque, gray.items[--gray.count]);
+  }
+  while (gray_allocated.count) {
+    gc_deque_push(&workers[next++ % worker_count].deque,
+                  gray_allocated.items[--gray_allocated.count]);
+  }
+
+  idle_markers = 0;
+  parallel_marking = 1;
+
+  pthread_mutex_lock(&pool_lock);
+  ++pool_generation;
+  pool_busy = worker_count - 1;
+  pthread_cond_broadcast(&pool_start);
+  pthread_mutex_unlock(&pool_lock);
+
+  gc_parallel_mark(&workers[0]);
+
+  pthread_mutex_lock(&pool_lock);
+  while (pool_busy) {
+    pthread_cond_wait(&pool_done, &pool_lock);
+  }
+  pthread_mutex_unlock(&pool_lock);
+
+  parallel_marking = 0;
+}
+
+static void gc_mark_roots(void) {
+  if (roots) {
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, roots);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      gc_mark(key);
+    }
+  }
+
+  for (struct gcframe *frame = frames; frame; frame = frame->prev) {
+    for (size_t i = 0; i < frame->count; ++i) {
+      void *ptr = *frame->slots[i];
+
+      // Locals may legitimately hold the statically allocated atoms, which aren't GC objects.
+      if (ptr && !is_static_atom((struct atom *)ptr)) {
+        gc_mark(ptr);
+      }
+    }
+  }
+
+  intern_gc_mark();
+}
+
+// Clears the young bits of every slab allocated from since the last collection, promoting their
+// surviving objects to the old generation.
+static void gc_young_clear(void) {
+  struct gcslab *slab = young_slabs;
+  while (slab) {
+    struct gcslab *next = slab->next_young;
+
+    size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+    for (size_t w = 0; w < words; ++w) {
+      slab->young_bits[w] = 0;
+    }
+
+    slab->next_young = NULL;
+    slab->on_young_list = 0;
+    slab = next;
+  }
+
+  young_slabs = NULL;
+}
+
+// Finishes a full collection: marks everything still unmarked and sweeps. If an incremental
+// collection is in progress, the roots are scanned again as frames and retained roots aren't
+// covered by the write barrier. A lazy collection only sweeps the (rare) dedicated slabs here and
+// leaves the rest to gc_new and gc_maybe_run, so the pause depends on the live data alone. Returns
+// the number of bytes freed during the pause.
+static size_t gc_finish(int lazy) {
+  gc_sweep_pending();
+
+  // Mark phase
+  gc_mark_roots();
+  if (worker_count > 1) {
+    gc_mark_parallel();
+  }
+  gc_mark_drain(0);
+  incremental_marking = 0;
+
+  // Every survivor of a full collection is old, so nothing needs remembering any more.
+  gc_remset_clear();
+  gc_young_clear();
+
+  struct gcsweep_stats stats = {0, 0, 0, 0, 0};
+  size_t lazy_bytes = 0;
+
+  // Sweep phase
+  for (size_t i = 0; i < GC_TYPE_COUNT; ++i) {
+    struct gcclass *cls = &classes[i];
+
+    for (struct gcslab *slab = cls->free_slabs; slab; slab = slab->next_free) {
+      slab->on_free_list = 0;
+    }
+    cls->free_slabs = NULL;
+
+    struct gcslab *slab = cls->slabs;
+    while (slab) {
+      struct gcslab *next = slab->next;
+
+      if (lazy) {
+        gc_count_slab(slab, &stats);
+        slab->next_sweep = cls->unswept;
+        cls->unswept = slab;
+        ++unswept_slabs;
+      } else {
+        gc_class_sweep_slab(cls, slab, &stats);
+      }
+
+      slab = next;
+    }
+  }
+
+  if (lazy) {
+    lazy_bytes = stats.total_bytes - stats.remaining_bytes;
+    lazy_stats = (struct gcsweep_stats){0, 0, 0, 0, 0};
+  }
+
+  struct gcslab *slab = large_slabs;
+  struct gcslab *prev = NULL;
+  while (slab) {
+    struct gcslab *next = slab->next;
+
+    gc_sweep_slab(slab, &stats);
+
+    if (slab->live == 0) {
+      if (prev) {
+        prev->next = next;
+      } else {
+        large_slabs = next;
+      }
+
+      gc_slab_free(slab);
+    } else {
+      prev = slab;
+    }
+
+    slab = next;
+  }
+
+  clog_debug(CLOG(LOGGER_GC), "GC: visited %zu nodes, skipped %zu, swept %zu", stats.visited,
+             stats.skipped, stats.swept);
+  clog_info(CLOG(LOGGER_GC),
+            "GC: started with %zu total bytes allocated, retained %zu bytes, freed %zu bytes "
+            "(%zu of them lazily)",
+            stats.total_bytes, stats.remaining_bytes, stats.total_bytes - stats.remaining_bytes,
+            lazy_bytes);
+
+  old_bytes = stats.remaining_bytes;
+  promoted_bytes = 0;
+  allocated_bytes = 0;
+  external_allocated_bytes = 0;
+  gc_update_budgets();
+
+  return stats.total_bytes - stats.remaining_bytes - lazy_bytes;
+}
+
+// Gives up on an incremental collection in progress, so that the next collection marks from
+// scratch. Finishing it instead would keep everything it marked, including objects that have
+// become unreachable since (and everything allocated since, which starts out marked).
+static void gc_abandon_marking(void) {
+  if (!incremental_marking) {
+    return;
+  }
+
+  for (size_t i = 0; i < GC_TYPE_COUNT + 1; ++i) {
+    struct gcslab *slab = i < GC_TYPE_COUNT ? classes[i].slabs : large_slabs;
+    for (; slab; slab = slab->next) {
+      size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+      for (size_t w = 0; w < words; ++w) {
+        slab->mark_bits[w] = 0;
+      }
+    }
+  }
+
+  gray.count = 0;
+  gray_allocated.count = 0;
+  mark_overflow = 0;
+  incremental_marking = 0;
+
+  clog_debug(CLOG(LOGGER_GC), "GC: abandoned incremental marking for a full collection");
+}
+
+size_t gc_run(void) {
+  size_t start = gc_now_us();
+  gc_abandon_marking();
+  size_t freed = gc_finish(0);
+  gc_record_pause(start);
+  return freed;
+}
+
+void *gc_forward(void *ptr) {
+  if (!ptr || is_static_atom((struct atom *)ptr)) {
+    return ptr;
+  }
+
+  // Evacuated cells are marked, and their first word holds the new address.
+  struct gcslab *slab = gc_slab_of(ptr);
+  if (slab->evacuating && gc_test_bit(slab->mark_bits, gc_slab_index(slab, ptr))) {
+    return *(void **)ptr;
+  }
+
+  return ptr;
+}
+
+// Points the children of an object that were moved at their new addresses.
+static void gc_update_children(void *ptr) {
+  switch (gc_slab_of(ptr)->type) {
+    case GC_TYPE_ATOM:
+    case GC_TYPE_CONS:
+    case GC_TYPE_SYMBOL:
+      atom_update_children((struct atom *)ptr);
+      break;
+    case GC_TYPE_ENVIRONMENT:
+      environment_gc_update_children((struct environment *)ptr);
+      break;
+    case GC_TYPE_BINDING_CELL:
+      binding_cell_gc_update_children(ptr);
+      break;
+    case GC_TYPE_TOKEN:
+      break;
+    case GC_TYPE_LEXER:
+      lex_gc_update_children((struct lex *)ptr);
+      break;
+  }
+}
+
+// Returns 1 if the objects in a slab may not be moved. Slabs holding retained roots (whose
+// pointers live in C code) are pinned by the caller through their mark bits. Symbols and keywords,
+// which the intern tables point at, have slabs of their own that are never moved, and neither are
+// lexers, which point into themselves and are short-lived anyway.
+static int gc_slab_pinned(struct gcslab *slab) {
+  if (slab->type == GC_TYPE_LEXER || slab->type == GC_TYPE_SYMBOL) {
+    return 1;
+  }
+
+  size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+  for (size_t w = 0; w < words; ++w) {
+    if (slab->mark_bits[w]) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Moves every object out of the sparse slabs of a size class into its other slabs. Each old cell
+// is freed and marked, with the new address left in its first word. Returns the number of slabs
+// evacuated, or 0 if the class wasn't worth compacting.
+static size_t gc_evacuate_class(struct gcclass *cls) {
+  size_t sparse = 0;
+  for (struct gcslab *slab = cls->slabs; slab; slab = slab->next) {
+    if (slab->live * 100 < slab->capacity * GC_COMPACT_SPARSE_PERCENT && !gc_slab_pinned(slab)) {
+      slab->evacuating = 1;
+      ++sparse;
+    }
+  }
+
+  // A lone sparse slab would just move into a fresh one.
+  if (sparse < 2) {
+    for (struct gcslab *slab = cls->slabs; slab; slab = slab->next) {
+      slab->evacuating = 0;
+    }
+    return 0;
+  }
+
+  // Evacuated slabs must not be allocated from.
+  struct gcslab **link = &cls->free_slabs;
+  while (*link) {
+    if ((*link)->evacuating) {
+      (*link)->on_free_list = 0;
+      *link = (*link)->next_free;
+    } else {
+      link = &(*link)->next_free;
+    }
+  }
+
+  for (struct gcslab *slab = cls->slabs; slab; slab = slab->next) {
+    if (!slab->evacuating) {
+      continue;
+    }
+
+    size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+    for (size_t w = 0; w < words; ++w) {
+      uint64_t alloc = slab->alloc_bits[w];
+      while (alloc) {
+        size_t index = (w * GC_BITS_PER_WORD) + (size_t)__builtin_ctzll(alloc);
+        alloc &= alloc - 1;
+
+        void *cell = gc_slab_cell(slab, index);
+        struct gcslab *target = gc_class_slab(slab->type);
+        void *moved = target ? gc_slab_take(target) : NULL;
+        if (!moved) {
+          // The objects moved so far are forwarded, the rest just stay where they are, and the
+          // slabs are put back in use once the references have been updated.
+          fprintf(stderr, "Error: could not allocate memory for GC compaction\n");
+          return sparse;
+        }
+
+        memcpy(moved, cell, slab->cell_size);
+        *(void **)cell = moved;
+
+        gc_set_bit(slab->mark_bits, index);
+        slab->alloc_bits[w] &= ~((uint64_t)1 << (index % GC_BITS_PER_WORD));
+        --slab->live;
+      }
+    }
+  }
+
+  return sparse;
+}
+
+// Puts a slab that couldn't be fully evacuated back in use. The cells its objects were moved out of
+// (marked but no longer allocated) go on its free list, so this must only run once nothing needs
+// forwarding through them any more.
+static void gc_restore_evacuated(struct gcclass *cls, struct gcslab *slab) {
+  size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+  for (size_t w = 0; w < words; ++w) {
+    uint64_t moved = slab->mark_bits[w] & ~slab->alloc_bits[w];
+    while (moved) {
+      size_t index = (w * GC_BITS_PER_WORD) + (size_t)__builtin_ctzll(moved);
+      moved &= moved - 1;
+
+      void *cell = gc_slab_cell(slab, index);
+      *(void **)cell = slab->free;
+      slab->free = cell;
+    }
+  }
+
+  if (slab->live < slab->capacity && !slab->on_free_list) {
+    slab->next_free = cls->free_slabs;
+    slab->on_free_list = 1;
+    cls->free_slabs = slab;
+  }
+}
+
+// Evacuates sparse slabs after a full, eagerly swept collection, then updates every reference to
+// a moved object and gives the evacuated slabs back to the OS.
+static void gc_compact_heap(void) {
+  // Mark bits are all clear after sweeping, so they can pin the retained roots.
+  if (roots) {
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, roots);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      struct gcslab *slab = gc_slab_of(key);
+      gc_set_bit(slab->mark_bits, gc_slab_index(slab, key));
+    }
+  }
+
+  size_t evacuated = 0;
+  for (size_t i = 0; i < GC_TYPE_COUNT; ++i) {
+    evacuated += gc_evacuate_class(&classes[i]);
+  }
+
+  if (!evacuated) {
+    clog_debug(CLOG(LOGGER_GC), "GC: no slabs sparse enough to compact");
+  }
+
+  for (struct gcframe *frame = frames; frame; frame = frame->prev) {
+    for (size_t i = 0; i < frame->count; ++i) {
+      *frame->slots[i] = gc_forward(*frame->slots[i]);
+    }
+  }
+
+  // Update every object still allocated where it is, including the ones just moved there.
+  size_t released = 0;
+  for (size_t i = 0; i < GC_TYPE_COUNT + 1; ++i) {
+    struct gcslab *slab = i < GC_TYPE_COUNT ? classes[i].slabs : large_slabs;
+    while (slab) {
+      struct gcslab *next = slab->next;
+
+      size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+      for (size_t w = 0; w < words && evacuated; ++w) {
+        uint64_t alloc = slab->alloc_bits[w];
+        while (alloc) {
+          size_t index = (w * GC_BITS_PER_WORD) + (size_t)__builtin_ctzll(alloc);
+          alloc &= alloc - 1;
+          gc_update_children(gc_slab_cell(slab, index));
+        }
+      }
+
+      slab = next;
+    }
+  }
+
+  for (size_t i = 0; i < GC_TYPE_COUNT && evacuated; ++i) {
+    struct gcclass *cls = &classes[i];
+    struct gcslab *slab = cls->slabs;
+    while (slab) {
+      struct gcslab *next = slab->next;
+
+      if (slab->evacuating && slab->live == 0) {
+        // The objects now live elsewhere, so the cells are unmapped without erasing them.
+        if (slab->prev) {
+          slab->prev->next = slab->next;
+        } else {
+          cls->slabs = slab->next;
+        }
+        if (slab->next) {
+          slab->next->prev = slab->prev;
+        }
+
+        released += slab->mapped;
+        gc_slab_free(slab);
+      } else if (slab->evacuating) {
+        // Evacuation ran out of memory before getting to all of this slab.
+        gc_restore_evacuated(cls, slab);
+      }
+
+      slab = next;
+    }
+  }
+
+  // Only now that nothing needs forwarding any more can the marks go.
+  for (size_t i = 0; i < GC_TYPE_COUNT + 1; ++i) {
+    struct gcslab *slab = i < GC_TYPE_COUNT ? classes[i].slabs : large_slabs;
+    for (; slab; slab = slab->next) {
+      size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+      for (size_t w = 0; w < words; ++w) {
+        slab->mark_bits[w] = 0;
+      }
+      slab->evacuating = 0;
+    }
+  }
+
+  if (evacuated) {
+    clog_info(CLOG(LOGGER_GC), "GC: compacted %zu sparse slabs, released %zu bytes", evacuated,
+              released);
   }
+}
+
+size_t gc_compact(void) {
+  size_t start = gc_now_us();
+  gc_abandon_marking();
+  size_t freed = gc_finish(0);
+  gc_compact_heap();
+  gc_record_pause(start);
+  return freed;
+}
+
+// Sweeps the young cells of a slab. Dead young cells go back on the free list and survivors are
+// promoted by clearing their young bit. Old cells are not touched. Like gc_sweep_slab, this
+// sweeps from the end of the slab.
+static void gc_sweep_young_slab(struct gcslab *slab, struct gcsweep_stats *stats) {
+  size_t words = (slab->bump + GC_BITS_PER_WORD - 1) / GC_BITS_PER_WORD;
+  for (size_t w = words; w-- > 0;) {
+    uint64_t young = slab->young_bits[w];
+    if (!young) {
+      continue;
+    }
+
+    uint64_t marked = slab->mark_bits[w];
+    uint64_t dead = young & ~marked;
+
+    size_t live = (size_t)__builtin_popcountll(young & marked);
+    stats->visited += live;
+    stats->skipped += live;
+    stats->total_bytes += live * slab->cell_size;
+    stats->remaining_bytes += live * slab->cell_size;
+
+    slab->alloc_bits[w] &= ~dead;
+    slab->young_bits[w] = 0;
+    slab->mark_bits[w] = 0;
+
+    while (dead) {
+      size_t bit = GC_BITS_PER_WORD - 1 - (size_t)__builtin_clzll(dead);
+      size_t index = (w * GC_BITS_PER_WORD) + bit;
+      dead &= ~((uint64_t)1 << bit);
+
+      void *cell = gc_slab_cell(slab, index);
+
+      ++stats->visited;
+      ++stats->swept;
+      stats->total_bytes += slab->cell_size;
 
-  struct gcnode *current = gc_head;
-  while (current) {
-    struct gcnode *next = current->next;
-    free(current);
-    current = next;
+      gc_erase(slab->type, cell);
+
+      *(void **)cell = slab->free;
+      slab->free = cell;
+      --slab->live;
+    }
+  }
+}
+
+size_t gc_run_minor(void) {
+  size_t start = gc_now_us();
+
+  if (incremental_marking) {
+    // Young objects are already being marked by the full collection, so finish that instead.
+    size_t freed = gc_finish(0);
+    gc_record_pause(start);
+    return freed;
   }
 
-  gc_head = NULL;
-  gc_tail = NULL;
+  gc_sweep_pending();
+
+  // Mark phase - only young objects are marked. The remembered set supplies the old objects that
+  // may point into the nursery. Those aren't young so are never marked themselves, but their
+  // children need to be traced.
+  minor_collection = 1;
+
+  gc_mark_roots();
+  for (size_t i = 0; i < remset.count; ++i) {
+    gc_mark_children(remset.items[i]);
+  }
+  gc_mark_drain(0);
+
+  minor_collection = 0;
+
+  gc_remset_clear();
+
+  struct gcsweep_stats stats = {0, 0, 0, 0, 0};
+
+  // Sweep phase - only slabs that allocated since the last collection can hold young objects.
+  struct gcslab *slab = young_slabs;
+  while (slab) {
+    struct gcslab *next = slab->next_young;
+
+    gc_sweep_young_slab(slab, &stats);
+
+    if (slab->live == 0) {
+      // Nothing survived, so the slab goes back to being a pure bump-allocated nursery slab.
+      slab->free = NULL;
+      slab->bump = 0;
+    }
+
+    if (slab->live < slab->capacity && !slab->on_free_list) {
+      struct gcclass *cls = &classes[slab->type];
+      if (slab->capacity > 1) {
+        slab->next_free = cls->free_slabs;
+        slab->on_free_list = 1;
+        cls->free_slabs = slab;
+      }
+    }
+
+    slab->next_young = NULL;
+    slab->on_young_list = 0;
+    slab = next;
+  }
+
+  young_slabs = NULL;
+
+  promoted_bytes += stats.remaining_bytes;
+  allocated_bytes = 0;
+  external_allocated_bytes = 0;
+
+  clog_debug(CLOG(LOGGER_GC), "GC: minor visited %zu nodes, promoted %zu, swept %zu",
+             stats.visited, stats.skipped, stats.swept);
+
+  gc_record_pause(start);
+
+  return stats.total_bytes - stats.remaining_bytes;
+}
+
+// Finishes a full collection started by gc_maybe_run or gc_maybe_compact, in the pause that is
+// already being timed. A compacting collection needs every slab swept before it can move objects.
+static size_t gc_finish_maybe(int compact) {
+  if (!compact) {
+    return gc_finish(1);
+  }
+
+  size_t freed = gc_finish(0);
+  gc_compact_heap();
+  return freed;
+}
+
+// Runs one slice of an incremental collection, if enough has been allocated since the last one.
+static size_t gc_step(int compact) {
+  if (gc_allocated_bytes() - step_allocated_bytes < GC_STEP_BYTES) {
+    return 0;
+  }
+
+  step_allocated_bytes = gc_allocated_bytes();
+
+  size_t start = gc_now_us();
+  size_t deadline = start + (size_t)params[GC_PARAM_MAX_PAUSE];
+
+  size_t freed = 0;
+  if (gc_mark_drain(deadline) && gc_now_us() < deadline) {
+    freed = gc_finish_maybe(compact);
+  } else if (gc_heap_bytes() >= 2 * mark_start_bytes) {
+    // The heap doubled while marking, which isn't keeping up with allocation, so give up on
+    // bounding this pause.
+    clog_debug(CLOG(LOGGER_GC), "GC: incremental marking fell behind, finishing");
+    freed = gc_finish_maybe(compact);
+  }
+
+  gc_record_pause(start);
+  return freed;
+}
+
+static size_t gc_maybe_collect(int compact) {
+  size_t freed = 0;
+  if (unswept_slabs) {
+    size_t start = gc_now_us();
+    freed = gc_sweep_step(GC_SWEEP_STEP_SLABS);
+    gc_record_pause(start);
+  }
+
+  if (incremental_marking) {
+    return freed + gc_step(compact);
+  }
+
+  if (gc_heap_bytes() >= heap_budget) {
+    if (incremental) {
+      clog_debug(CLOG(LOGGER_GC), "GC: heap budget of %zu bytes reached, starting to mark",
+                 heap_budget);
+
+      size_t start = gc_now_us();
+      gc_sweep_pending();
+      incremental_marking = 1;
+      step_allocated_bytes = gc_allocated_bytes();
+      mark_start_bytes = gc_heap_bytes();
+      gc_mark_roots();
+      gc_record_pause(start);
+      return freed;
+    }
+
+    clog_debug(CLOG(LOGGER_GC), "GC: heap budget of %zu bytes reached, running full",
+               heap_budget);
+
+    size_t start = gc_now_us();
+    freed += gc_finish_maybe(compact);
+    gc_record_pause(start);
+
+    // Get a head start on sweeping, which also frees something right away.
+    start = gc_now_us();
+    freed += gc_sweep_step(GC_SWEEP_STEP_SLABS);
+    gc_record_pause(start);
+    return freed;
+  }
+
+  if (gc_allocated_bytes() >= nursery_budget) {
+    return freed + gc_run_minor();
+  }
+
+  return freed;
+}
+
+size_t gc_maybe_run(void) {
+  return gc_maybe_collect(0);
+}
+
+size_t gc_maybe_compact(void) {
+  return gc_maybe_collect(1);
+}
+
+int gc_set_param(enum GCParam param, int value) {
+  if (param < 0 || param >= GC_PARAM_COUNT || value <= 0) {
+    return -1;
+  }
+
+  int previous = params[param];
+  params[param] = value;
+  gc_update_budgets();
+  return previous;
+}
+
+int gc_set_threads(int threads) {
+  if (threads < 1) {
+    return -1;
+  }
+
+  int previous = (int)worker_count;
+  if ((size_t)threads == worker_count) {
+    return previous;
+  }
+
+  gc_pool_stop();
+  if (threads > 1 && gc_pool_start((size_t)threads) != 0) {
+    fprintf(stderr, "Warning: could not start %d GC marker threads\n", threads);
+    return -1;
+  }
+
+  return previous;
+}
+
+void gc_set_incremental(int enabled) {
+  incremental = enabled;
+}
+
+int gc_is_marking(void) {
+  return incremental_marking;
+}
+
+void gc_pause_stats(struct gcpause_stats *stats) {
+  *stats = pauses;
+}
+
+static void gc_free_slab_list(struct gcslab *slab, int *uncollected) {
+  while (slab) {
+    struct gcslab *next = slab->next;
+    if (slab->live) {
+      *uncollected = 1;
+    }
+
+    gc_slab_free(slab);
+    slab = next;
+  }
+}
+
+void gc_shutdown(void) {
+  int uncollected = 0;
+
+  for (size_t i = 0; i < GC_TYPE_COUNT; ++i) {
+    gc_free_slab_list(classes[i].slabs, &uncollected);
+    gc_free_slab_list(classes[i].spare, &uncollected);
+
+    classes[i].slabs = NULL;
+    classes[i].free_slabs = NULL;
+    classes[i].spare = NULL;
+    classes[i].unswept = NULL;
+  }
+  unswept_slabs = 0;
+
+  gc_free_slab_list(large_slabs, &uncollected);
+  large_slabs = NULL;
+  young_slabs = NULL;
+
+  if (roots) {
+    g_hash_table_destroy(roots);
+    roots = NULL;
+  }
+  frames = NULL;
+
+  gc_pool_stop();
+
+  gc_stack_free(&remset);
+  gc_stack_free(&gray);
+  gc_stack_free(&gray_allocated);
+  incremental_marking = 0;
+
+  if (pauses.count) {
+    clog_info(CLOG(LOGGER_GC), "GC: %zu pauses, %zu us total, %zu us max", pauses.count,
+              pauses.total_us, pauses.max_us);
+    for (size_t i = 0; i < GC_PAUSE_BUCKETS; ++i) {
+      if (!pauses.buckets[i]) {
+        continue;
+      }
+
+      if (i < GC_PAUSE_BUCKETS - 1) {
+        clog_info(CLOG(LOGGER_GC), "GC: pauses under %zu us: %zu", (size_t)1 << i,
+                  pauses.buckets[i]);
+      } else {
+        clog_info(CLOG(LOGGER_GC), "GC: pauses of %zu us or more: %zu", (size_t)1 << (i - 1),
+                  pauses.buckets[i]);
+      }
+    }
+  }
+
+  if (uncollected) {
+    fprintf(stderr, "Warning: GC shutdown called with uncollected nodes\n");
+  }
 }
@@ -9,23 +9,150 @@ enum GCType {
   GC_TYPE_BINDING_CELL = 2,  // Binding cell in environment
   GC_TYPE_TOKEN = 3,         // Lexer token
   GC_TYPE_LEXER = 4,         // Lexer state
+  GC_TYPE_CONS = 5,          // Cons cell (a bare struct cons, see atom.h)
+  GC_TYPE_SYMBOL = 6,        // Interned symbol or keyword atom, kept apart since it can't move
 };
 
+// Tunables for when gc_maybe_run decides a collection is due, in the spirit of Lua's
+// collectgarbage() parameters.
+enum GCParam {
+  // A full collection is due once the heap reaches this percentage of its size after the previous
+  // full collection (e.g. 200 waits for the heap to double).
+  GC_PARAM_PAUSE = 0,
+  // A minor collection is due after allocating this percentage of the heap size left by the
+  // previous full collection.
+  GC_PARAM_MINOR_MUL = 1,
+  // In incremental mode, the longest a single marking slice may run for, in microseconds.
+  GC_PARAM_MAX_PAUSE = 2,
+  GC_PARAM_COUNT,
+};
+
+// Pause histogram buckets. Bucket 0 counts pauses under 1us and bucket i counts pauses of
+// [2^(i-1), 2^i) microseconds, with the last bucket also taking anything longer.
+#define GC_PAUSE_BUCKETS 16
+
+struct gcpause_stats {
+  size_t count;
+  size_t total_us;
+  size_t max_us;
+  size_t buckets[GC_PAUSE_BUCKETS];
+};
+
+// A frame of local variables registered as GC roots for the duration of a C function. Frames live
+// on the C stack and are linked together, so registering and releasing them never allocates.
+// Use GC_PUSH_FRAME/GC_POP_FRAME rather than filling one in by hand.
+struct gcframe {
+  struct gcframe *prev;
+  size_t count;
+  void **const *slots;  // addresses of the local variables holding GC pointers
+};
+
+// Wraps a local variable holding a GC pointer (or NULL) for GC_PUSH_FRAME.
+#define GC_ROOT(var) ((void **)&(var))
+
+// Registers the given GC_ROOT-wrapped locals as roots until the matching GC_POP_FRAME. The GC
+// reads the variables when it runs, so they may be reassigned freely in between. Frames must be
+// popped in the reverse order they were pushed, on every path out of the function.
+#define GC_PUSH_FRAME(frame, ...)                                                   \
+  void **const frame##_slots[] = {__VA_ARGS__};                                    \
+  struct gcframe frame = {NULL, sizeof(frame##_slots) / sizeof(frame##_slots[0]), \
+                          frame##_slots};                                           \
+  gc_push_frame(&frame)
+
+#define GC_POP_FRAME(frame) gc_pop_frame(&frame)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void *gc_new(enum GCType type, size_t size);
 
+// Returns the type an object was allocated with.
+enum GCType gc_type_of(void *ptr);
+
+// Retains a long-lived root (e.g. a global environment) until the matching gc_release. Prefer
+// GC_PUSH_FRAME for roots that only need to live as long as a function call.
 void gc_retain(void *ptr);
 void gc_release(void *ptr);
 
-// Returns 1 if the pointer was already marked, 0 otherwise.
+void gc_push_frame(struct gcframe *frame);
+void gc_pop_frame(struct gcframe *frame);
+
+// Marks the object and queues it for tracing; the GC visits its children later via the type's
+// *_mark_children function, so marking never recurses. Returns 1 if the pointer was already
+// marked, 0 otherwise.
 int gc_mark(void *ptr);
 
+// Marks the object without queueing it, for callers that trace its children themselves (e.g. to
+// walk a list's cdr chain in a loop). Returns 1 if the pointer was already marked, 0 otherwise.
+int gc_set_mark(void *ptr);
+
+// Must be called after storing a pointer to a GC object into an existing GC object (the owner).
+// Objects that survive a collection are promoted to the old generation, and old objects that
+// point at young objects need to be known to minor collections. While an incremental collection
+// is marking, an owner that was already traced is queued to be traced again.
+void gc_write_barrier(void *owner);
+
+// Accounts for memory a GC object owns outside the GC heap, such as a vector's items, which the
+// collection budgets would otherwise never see: call gc_note_external with the size of each such
+// allocation (or the growth of a reallocation), and gc_forget_external when it's freed (or
+// shrinks). Objects that own a lot of it then make collections due as soon as GC objects do.
+void gc_note_external(size_t size);
+void gc_forget_external(size_t size);
+
 void gc_init(void);
 // Run a full garbage collection cycle. Returns the numbe of bytes collected.
 size_t gc_run(void);
+// Run a minor collection, which only collects objects allocated since the last collection. Returns
+// the number of bytes collected.
+size_t gc_run_minor(void);
+
+// Runs a minor or full collection if enough has been allocated since the last one to make it due,
+// otherwise does nothing. In incremental mode a due full collection instead starts marking, and
+// later calls each mark for at most GC_PARAM_MAX_PAUSE microseconds until it can finish. A full
+// collection started here leaves most of its sweeping to later calls and to gc_new. Only call
+// this at a point where every live object is reachable from a root. Returns the number of bytes
+// collected.
+size_t gc_maybe_run(void);
+
+// Runs a full collection like gc_run, then compacts the heap: the objects in sparse slabs are
+// moved into other slabs and the emptied slabs are given back to the OS. References from GC
+// objects and frames are updated. Retained roots, symbols and keywords (which the intern tables
+// point at) and lexers are never moved. Only call this where every pointer to a GC object held by
+// C code is in a frame or retained. Returns the number of bytes collected.
+size_t gc_compact(void);
+
+// Like gc_maybe_run, but a due full collection also compacts the heap as gc_compact does, for
+// long-running processes whose heaps would otherwise fragment. The same restrictions as for
+// gc_compact apply.
+size_t gc_maybe_compact(void);
+
+// Returns the current address of an object, which only differs from ptr while gc_compact is
+// updating references to moved objects. For the *_update_children functions of each type.
+void *gc_forward(void *ptr);
+
+// Sets the number of threads that mark during a full collection, including the collecting thread,
+// starting or stopping a pool of marker threads as needed (1, the default, marks serially).
+// Returns the previous thread count, or -1 if the count is invalid or the threads can't be started,
+// in which case marking is serial.
+int gc_set_threads(int threads);
+
+// Enables or disables incremental full collections in gc_maybe_run (off by default). gc_run and
+// gc_compact always mark from scratch, abandoning a collection in progress, whose marks may be
+// stale. gc_run_minor finishes one in progress instead, as minor collections can't run while a
+// full collection is marking.
+void gc_set_incremental(int enabled);
+
+// Returns 1 while an incremental full collection is marking, 0 otherwise.
+int gc_is_marking(void);
+
+// Fills in a histogram of the time spent in every collection pause so far (full and minor
+// collections, and incremental marking slices).
+void gc_pause_stats(struct gcpause_stats *stats);
+
+// Sets a collection tunable, returning its previous value or -1 if the parameter or value are
+// invalid. Values must be positive.
+int gc_set_param(enum GCParam param, int value);
 void gc_shutdown(void);
 
 #ifdef __cplusplus
@@ -11,6 +11,9 @@
 static GHashTable *symbol_table = NULL;
 static GHashTable *keyword_table = NULL;
 
+// Not reset with the tables, so that a symbol interned after a cleanup never reuses an id.
+static uint32_t next_symbol_id = 0;
+
 void init_intern_tables(void) {
   symbol_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   keyword_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
@@ -40,10 +43,10 @@ struct atom *intern(const char *name, int is_keyword) {
     return existing;
   }
 
-  union atom_value value = {.string = {.ptr = g_strdup(name), .len = strlen(name)}};
   enum AtomType atom_type = is_keyword ? ATOM_TYPE_KEYWORD : ATOM_TYPE_SYMBOL;
 
-  struct atom *atom = new_atom(atom_type, value);
+  struct atom *atom = new_symbol(atom_type, name, strlen(name));
+  atom->symbol_id = next_symbol_id++;
 
   clog_debug(CLOG(LOGGER_INTERN), "interned %s as %p", name, (void *)atom);
 
@@ -63,4 +66,10 @@ void intern_gc_mark(void) {
     struct atom *atom = (struct atom *)value;
     gc_mark(atom);
   }
+
+  g_hash_table_iter_init(&iter, keyword_table);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    struct atom *atom = (struct atom *)value;
+    gc_mark(atom);
+  }
 }
@@ -38,6 +38,10 @@ static const char *token_type_to_string(enum Token type) {
       return "BACKTICK";
     case TOKEN_COMMA:
       return "COMMA";
+    case TOKEN_LBRACKET:
+      return "LBRACKET";
+    case TOKEN_RBRACKET:
+      return "RBRACKET";
     default:
       return "UNKNOWN";
   }
@@ -81,7 +85,8 @@ static void lex_consume_whitespace(struct lex *lexer) {
 
 // returns 1 if the character terminates an atom, 0 otherwise
 static int is_terminator(char c) {
-  return isspace(c) || c == '(' || c == ')' || c == ';' || c == '"' || c == '\'' || c == EOF;
+  return isspace(c) || c == '(' || c == ')' || c == '[' || c == ']' || c == ';' || c == '"' ||
+         c == '\'' || c == EOF;
 }
 
 static int read_until_terminator(struct lex *lexer, char terminator, char *buffer,
@@ -210,6 +215,15 @@ struct token *lex_peek_token(struct lex *lexer) {
       lexer->current_token->length = 1;
     } break;
 
+    case '[':
+    case ']': {
+      char buf[2] = {c, '\0'};
+      lexer->current_token = gc_new(GC_TYPE_TOKEN, sizeof(struct token));
+      lexer->current_token->type = c == '[' ? TOKEN_LBRACKET : TOKEN_RBRACKET;
+      lexer->current_token->text = strdup(buf);
+      lexer->current_token->length = 1;
+    } break;
+
     case '\'': {
       lexer->current_token = gc_new(GC_TYPE_TOKEN, sizeof(struct token));
       lexer->current_token->type = TOKEN_QUOTE;
@@ -274,6 +288,8 @@ struct token *lex_peek_token(struct lex *lexer) {
       }
   }
 
+  gc_write_barrier(lexer);
+
   clog_debug(CLOG(LOGGER_LEX), "lex_peek_token: %s %s",
              token_type_to_string(lexer->current_token->type),
              lexer->current_token->text ? lexer->current_token->text : "NULL");
@@ -299,13 +315,21 @@ void lex_gc_mark(struct lex *lexer) {
     return;
   }
 
-  if (gc_mark(lexer)) {
+  gc_mark(lexer);
+}
+
+void lex_gc_mark_children(struct lex *lexer) {
+  if (lexer->current_token == &lexer->eof) {
     return;
   }
 
+  gc_mark(lexer->current_token);
+}
+
+void lex_gc_update_children(struct lex *lexer) {
   if (lexer->current_token == &lexer->eof) {
     return;
   }
 
-  gc_mark(lexer->current_token);
+  lexer->current_token = gc_forward(lexer->current_token);
 }
@@ -24,6 +24,10 @@ enum Token {
   TOKEN_BACKTICK = 8,
   // The , character, used for unquoting
   TOKEN_COMMA = 9,
+  // Left bracket, starting a vector
+  TOKEN_LBRACKET = 10,
+  // Right bracket
+  TOKEN_RBRACKET = 11,
 };
 
 struct token {
@@ -50,6 +54,8 @@ struct token *lex_peek_token(struct lex *lexer);
 void lex_gc_erase(struct lex *lexer);
 void lex_gc_erase_token(struct token *token);
 void lex_gc_mark(struct lex *lexer);
+void lex_gc_mark_children(struct lex *lexer);
+void lex_gc_update_children(struct lex *lexer);
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -14,6 +14,7 @@
 #include "print.h"
 #include "read.h"
 #include "source.h"
+#include "special.h"
 
 int main(int argc, char *argv[]) {
   logging_init(1, CLOG_DEBUG);
@@ -109,7 +110,9 @@ int main(int argc, char *argv[]) {
       printf("\n");
     }
 
-    gc_run();
+    // Nothing but env (which is retained) is live between top-level forms, so objects can be
+    // moved here to keep a long-running REPL's heap from fragmenting.
+    gc_maybe_compact();
   }
 
   int rc = 0;
@@ -128,6 +131,8 @@ int main(int argc, char *argv[]) {
 
   gc_release(env);
 
+  cleanup_special_forms();
+  env_reset_shadows();
   cleanup_intern_tables();
 
   gc_run();
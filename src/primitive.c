@@ -4,41 +4,50 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "array.h"
 #include "atom.h"
+#include "bignum.h"
 #include "eval.h"
+#include "gc.h"
 #include "intern.h"
 #include "print.h"
 #include "read.h"
 #include "source.h"
+#include "table.h"
 
 static struct atom *primitive_function(PrimitiveFunction func) {
   union atom_value value = {.primitive = func};
   return new_atom(ATOM_TYPE_PRIMITIVE, value);
 }
 
-typedef int64_t (*IArithmeticFunction)(int64_t, int64_t);
+typedef int (*IArithmeticFunction)(int64_t, int64_t, int64_t *);
+typedef struct atom *(*BignumArithmeticFunction)(struct atom *, struct atom *);
 typedef double (*FArithmeticFunction)(double, double);
 
 typedef int (*ComparisonFunction)(struct atom *, struct atom *);
 
-static int64_t iadd(int64_t a, int64_t b) {
-  return a + b;
+// The integer operations return 0 if the result doesn't fit an int64_t, for iarithmetic to redo
+// the operation on bignums.
+static int iadd(int64_t a, int64_t b, int64_t *result) {
+  return !__builtin_add_overflow(a, b, result);
 }
 
-static int64_t isub(int64_t a, int64_t b) {
-  return a - b;
+static int isub(int64_t a, int64_t b, int64_t *result) {
+  return !__builtin_sub_overflow(a, b, result);
 }
 
-static int64_t imul(int64_t a, int64_t b) {
-  return a * b;
+static int imul(int64_t a, int64_t b, int64_t *result) {
+  return !__builtin_mul_overflow(a, b, result);
 }
 
-static int64_t idiv(int64_t a, int64_t b) {
-  if (b == 0) {
-    fprintf(stderr, "Error: division by zero\n");
+// A zero divisor is also left to bignum_div, which reports it as an error whatever the dividend.
+static int idiv(int64_t a, int64_t b, int64_t *result) {
+  if (b == 0 || (a == INT64_MIN && b == -1)) {
     return 0;
   }
-  return a / b;
+
+  *result = a / b;
+  return 1;
 }
 
 static double fadd(double a, double b) {
@@ -97,24 +106,30 @@ struct atom *primitive_cdr(struct atom *args, struct environment *env) {
   return cdr(atom);
 }
 
+// Returns the type of an arithmetic argument, counting bignums as integers.
+static enum AtomType arithmetic_type(struct atom *atom) {
+  enum AtomType type = atom_type_of(atom);
+  return type == ATOM_TYPE_BIGNUM ? ATOM_TYPE_INT : type;
+}
+
 static int check_arithmetic_args(struct atom *args, struct atom **error) {
   struct atom *first_arg = car(args);
-  enum AtomType type = first_arg->type;
+  enum AtomType type = arithmetic_type(first_arg);
 
   *error = NULL;
 
   args = cdr(args);
-  while (args && args->type == ATOM_TYPE_CONS) {
+  while (args && atom_type_of(args) == ATOM_TYPE_CONS) {
     struct atom *arg = car(args);
-    if (arg->type != ATOM_TYPE_INT && arg->type != ATOM_TYPE_FLOAT) {
+    if (arithmetic_type(arg) != ATOM_TYPE_INT && arithmetic_type(arg) != ATOM_TYPE_FLOAT) {
       *error = new_atom_error(arg, "arithmetic operations only support integers and floats, got %s",
-                              atom_type_to_string(arg->type));
+                              atom_type_to_string(atom_type_of(arg)));
       return 0;
-    } else if (arg->type != type) {
+    } else if (arithmetic_type(arg) != type) {
       *error = new_atom_error(first_arg,
                               "arithmetic operations require all arguments to be of the same type, "
                               "expected %s, got %s",
-                              atom_type_to_string(type), atom_type_to_string(arg->type));
+                              atom_type_to_string(type), atom_type_to_string(atom_type_of(arg)));
       return 0;
     }
     args = cdr(args);
@@ -123,34 +138,47 @@ static int check_arithmetic_args(struct atom *args, struct atom **error) {
   return 1;
 }
 
-struct atom *iarithmetic(struct atom *args, IArithmeticFunction func) {
+// Folds the arguments with func while the result fits an int64_t, and with bignum_func once it
+// doesn't (or an argument is a bignum), going back to func if the result becomes small again.
+struct atom *iarithmetic(struct atom *args, IArithmeticFunction func,
+                         BignumArithmeticFunction bignum_func) {
   struct atom *first_arg = car(args);
-  int64_t value = first_arg->value.ivalue;
+  struct atom *bignum = is_bignum(first_arg) ? first_arg : NULL;
+  int64_t value = bignum ? 0 : atom_int(first_arg);
 
   args = cdr(args);
   while (!is_nil(args)) {
     struct atom *arg = car(args);
-    value = func(value, arg->value.ivalue);
+    int64_t result;
+    if (!bignum && !is_bignum(arg) && func(value, atom_int(arg), &result)) {
+      value = result;
+    } else {
+      bignum = bignum_func(bignum ? bignum : new_int(value), arg);
+      if (is_error(bignum)) {
+        return bignum;
+      } else if (is_int(bignum)) {
+        value = atom_int(bignum);
+        bignum = NULL;
+      }
+    }
     args = cdr(args);
   }
 
-  union atom_value result_value = {.ivalue = value};
-  return new_atom(ATOM_TYPE_INT, result_value);
+  return bignum ? bignum : new_int(value);
 }
 
 struct atom *farithmetic(struct atom *args, FArithmeticFunction func) {
   struct atom *first_arg = car(args);
-  double value = first_arg->value.ivalue;
+  double value = atom_float(first_arg);
 
   args = cdr(args);
   while (!is_nil(args)) {
     struct atom *arg = car(args);
-    value = func(value, arg->value.ivalue);
+    value = func(value, atom_float(arg));
     args = cdr(args);
   }
 
-  union atom_value result_value = {.ivalue = value};
-  return new_atom(ATOM_TYPE_FLOAT, result_value);
+  return new_float(value);
 }
 
 struct atom *primitive_add(struct atom *args, struct environment *env) {
@@ -161,13 +189,13 @@ struct atom *primitive_add(struct atom *args, struct environment *env) {
     return error;
   }
 
-  if (car(args)->type == ATOM_TYPE_INT) {
-    return iarithmetic(args, iadd);
-  } else if (car(args)->type == ATOM_TYPE_FLOAT) {
+  if (arithmetic_type(car(args)) == ATOM_TYPE_INT) {
+    return iarithmetic(args, iadd, bignum_add);
+  } else if (atom_type_of(car(args)) == ATOM_TYPE_FLOAT) {
     return farithmetic(args, fadd);
   } else {
     return new_atom_error(car(args), "Error: '+' only supports integers and floats, got %s",
-                          atom_type_to_string(car(args)->type));
+                          atom_type_to_string(atom_type_of(car(args))));
   }
 }
 
@@ -179,13 +207,13 @@ struct atom *primitive_subtract(struct atom *args, struct environment *env) {
     return error;
   }
 
-  if (car(args)->type == ATOM_TYPE_INT) {
-    return iarithmetic(args, isub);
-  } else if (car(args)->type == ATOM_TYPE_FLOAT) {
+  if (arithmetic_type(car(args)) == ATOM_TYPE_INT) {
+    return iarithmetic(args, isub, bignum_sub);
+  } else if (atom_type_of(car(args)) == ATOM_TYPE_FLOAT) {
     return farithmetic(args, fsub);
   } else {
     return new_atom_error(car(args), "Error: '-' only supports integers and floats, got %s",
-                          atom_type_to_string(car(args)->type));
+                          atom_type_to_string(atom_type_of(car(args))));
   }
 }
 
@@ -197,13 +225,13 @@ struct atom *primitive_multiply(struct atom *args, struct environment *env) {
     return error;
   }
 
-  if (car(args)->type == ATOM_TYPE_INT) {
-    return iarithmetic(args, imul);
-  } else if (car(args)->type == ATOM_TYPE_FLOAT) {
+  if (arithmetic_type(car(args)) == ATOM_TYPE_INT) {
+    return iarithmetic(args, imul, bignum_mul);
+  } else if (atom_type_of(car(args)) == ATOM_TYPE_FLOAT) {
     return farithmetic(args, fmul);
   } else {
     return new_atom_error(car(args), "Error: '*' only supports integers and floats, got %s",
-                          atom_type_to_string(car(args)->type));
+                          atom_type_to_string(atom_type_of(car(args))));
   }
 }
 
@@ -215,13 +243,13 @@ struct atom *primitive_divide(struct atom *args, struct environment *env) {
     return error;
   }
 
-  if (car(args)->type == ATOM_TYPE_INT) {
-    return iarithmetic(args, idiv);
-  } else if (car(args)->type == ATOM_TYPE_FLOAT) {
+  if (arithmetic_type(car(args)) == ATOM_TYPE_INT) {
+    return iarithmetic(args, idiv, bignum_div);
+  } else if (atom_type_of(car(args)) == ATOM_TYPE_FLOAT) {
     return farithmetic(args, fdiv);
   } else {
     return new_atom_error(car(args), "Error: '/' only supports integers and floats, got %s",
-                          atom_type_to_string(car(args)->type));
+                          atom_type_to_string(atom_type_of(car(args))));
   }
 }
 
@@ -229,31 +257,35 @@ struct atom *primitive_equal(struct atom *args, struct environment *env) {
   (void)env;
 
   // Must be two arguments
-  if (!args || args->type != ATOM_TYPE_CONS || !args->value.cons.cdr ||
-      args->value.cons.cdr->type != ATOM_TYPE_CONS) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS || !atom_cons(args)->cdr ||
+      atom_type_of(atom_cons(args)->cdr) != ATOM_TYPE_CONS) {
     return new_atom_error(args, "Error: '=' requires exactly two arguments");
   }
 
   struct atom *first = car(args);
   struct atom *second = car(cdr(args));
 
-  if (first->type != second->type) {
+  if (atom_type_of(first) != atom_type_of(second)) {
     return atom_nil();
   }
 
   int equal = 0;
-  switch (first->type) {
+  switch (atom_type_of(first)) {
     case ATOM_TYPE_INT:
-      equal = (first->value.ivalue == second->value.ivalue);
+      equal = (atom_int(first) == atom_int(second));
+      break;
+    case ATOM_TYPE_BIGNUM:
+      equal = !bignum_compare(first, second);
       break;
     case ATOM_TYPE_FLOAT:
-      equal = (first->value.fvalue == second->value.fvalue);
+      equal = (atom_float(first) == atom_float(second));
       break;
     case ATOM_TYPE_STRING:
-      equal = (strcmp(first->value.string.ptr, second->value.string.ptr) == 0);
+      equal = first->value.string.len == second->value.string.len &&
+              !memcmp(first->value.string.ptr, second->value.string.ptr, first->value.string.len);
       break;
     case ATOM_TYPE_TRUE:
-      equal = (second->type == ATOM_TYPE_TRUE);
+      equal = (atom_type_of(second) == ATOM_TYPE_TRUE);
       break;
     case ATOM_TYPE_SYMBOL:
     case ATOM_TYPE_KEYWORD:
@@ -268,6 +300,10 @@ struct atom *primitive_equal(struct atom *args, struct environment *env) {
       return atom_nil();
       break;
     case ATOM_TYPE_CONS:
+    case ATOM_TYPE_VECTOR:
+    case ATOM_TYPE_TABLE:
+    case ATOM_TYPE_ARRAY:
+    case ATOM_TYPE_LOCAL:
     case ATOM_TYPE_NIL:
     case ATOM_TYPE_LAMBDA:
     case ATOM_TYPE_ERROR:
@@ -283,10 +319,10 @@ struct atom *primitive_equal(struct atom *args, struct environment *env) {
 struct atom *primitive_atomp(struct atom *args, struct environment *env) {
   (void)env;
 
-  struct atom *arg = car(args);
-  if (arg->type == ATOM_TYPE_INT || arg->type == ATOM_TYPE_FLOAT || arg->type == ATOM_TYPE_STRING ||
-      arg->type == ATOM_TYPE_SYMBOL || arg->type == ATOM_TYPE_KEYWORD ||
-      arg->type == ATOM_TYPE_TRUE || arg->type == ATOM_TYPE_NIL) {
+  enum AtomType type = atom_type_of(car(args));
+  if (type == ATOM_TYPE_INT || type == ATOM_TYPE_BIGNUM || type == ATOM_TYPE_FLOAT ||
+      type == ATOM_TYPE_STRING || type == ATOM_TYPE_SYMBOL || type == ATOM_TYPE_KEYWORD ||
+      type == ATOM_TYPE_TRUE || type == ATOM_TYPE_NIL) {
     return atom_true();
   }
 
@@ -339,11 +375,11 @@ struct atom *primitive_greater_than_equal(struct atom *args, struct environment
 struct atom *primitive_print(struct atom *args, struct environment *env) {
   (void)env;
 
-  if (!args || args->type != ATOM_TYPE_CONS) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS) {
     return new_atom_error(args, "Error: 'print' requires at least one argument");
   }
 
-  while (args && args->type == ATOM_TYPE_CONS) {
+  while (args && atom_type_of(args) == ATOM_TYPE_CONS) {
     print(stdout, car(args), 1);
     printf("\n");
     args = cdr(args);
@@ -355,11 +391,11 @@ struct atom *primitive_print(struct atom *args, struct environment *env) {
 struct atom *primitive_write(struct atom *args, struct environment *env) {
   (void)env;
 
-  if (!args || args->type != ATOM_TYPE_CONS) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS) {
     return new_atom_error(args, "Error: 'write' requires at least one argument");
   }
 
-  while (args && args->type == ATOM_TYPE_CONS) {
+  while (args && atom_type_of(args) == ATOM_TYPE_CONS) {
     print(stdout, car(args), 0);
     printf("\n");
     args = cdr(args);
@@ -371,7 +407,7 @@ struct atom *primitive_write(struct atom *args, struct environment *env) {
 struct atom *primitive_to_string(struct atom *args, struct environment *env) {
   (void)env;
 
-  if (!args || args->type != ATOM_TYPE_CONS) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS) {
     return new_atom_error(args, "Error: 'to-string' requires at least one argument");
   }
 
@@ -380,32 +416,34 @@ struct atom *primitive_to_string(struct atom *args, struct environment *env) {
     return new_atom_error(args, "Error: 'to-string' requires exactly one argument");
   }
 
-  char *buf = (char *)malloc(1024);
+  char *buf = string_buffer_new(1024);
   if (print_str(buf, 1024, arg, 0) <= 0) {
-    free(buf);
+    string_buffer_free(buf);
     return new_atom_error(arg, "Error: could not convert atom to string");
   }
 
-  union atom_value value = {.string = {.ptr = buf, .len = strlen(buf)}};
-  return new_atom(ATOM_TYPE_STRING, value);
+  buf[1023] = '\0';  // print_str may have filled the buffer without terminating it
+  return new_string_owned(ATOM_TYPE_STRING, buf, strlen(buf));
 }
 
 struct atom *primitive_read(struct atom *args, struct environment *env) {
   (void)env;
 
-  if (!args || args->type != ATOM_TYPE_CONS || !args->value.cons.car) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS || !atom_cons(args)->car) {
     return new_atom_error(args, "Error: 'read' requires one argument");
   }
 
   struct atom *input = car(args);
-  if (input->type != ATOM_TYPE_STRING) {
+  if (atom_type_of(input) != ATOM_TYPE_STRING) {
     return new_atom_error(input, "Error: 'read' argument must be a string");
   }
 
-  struct source_file *source = source_file_str(input->value.string.ptr, input->value.string.len);
+  // reading never reaches a GC safe point, so the string can be read in place
+  struct source_file *source =
+      source_file_str_view(input->value.string.ptr, input->value.string.len);
   if (!source) {
-    return new_atom_error(input, "Error: could not create source from string '%s'",
-                          input->value.string.ptr);
+    return new_atom_error(input, "Error: could not create source from string '%.*s'",
+                          (int)input->value.string.len, input->value.string.ptr);
   }
 
   struct atom *result = read_atom(source);
@@ -413,7 +451,8 @@ struct atom *primitive_read(struct atom *args, struct environment *env) {
   source_file_free(source);
 
   if (!result) {
-    return new_atom_error(input, "Error: could not read from string '%s'", input->value.string.ptr);
+    return new_atom_error(input, "Error: could not read from string '%.*s'",
+                          (int)input->value.string.len, input->value.string.ptr);
   }
 
   return result;
@@ -428,10 +467,14 @@ struct atom *primitive_slurp(struct atom *args, struct environment *env) {
   }
 
   struct atom *input = car(args);
+  char *path = atom_string_dup(input);
+  struct atom *result = NULL;
 
-  FILE *fp = fopen(input->value.string.ptr, "r");
+  FILE *fp = fopen(path, "r");
   if (!fp) {
-    return new_atom_error(input, "could not open file '%s'", input->value.string.ptr);
+    result = new_atom_error(input, "could not open file '%s'", path);
+    free(path);
+    return result;
   }
 
   fseek(fp, 0, SEEK_END);
@@ -439,40 +482,41 @@ struct atom *primitive_slurp(struct atom *args, struct environment *env) {
   fseek(fp, 0, SEEK_SET);
 
   if (size < 0) {
-    fclose(fp);
-    return new_atom_error(input, "could not determine size of file '%s'", input->value.string.ptr);
+    result = new_atom_error(input, "could not determine size of file '%s'", path);
+  } else {
+    // read straight into a string buffer, which the result then uses without another copy
+    char *buffer = string_buffer_new(size + 1);
+    if (fread(buffer, 1, size, fp) != (size_t)size) {
+      string_buffer_free(buffer);
+      result = new_atom_error(input, "could not slurp '%s' - short or failed read", path);
+    } else {
+      result = new_string_owned(ATOM_TYPE_STRING, buffer, size);
+    }
   }
 
-  char *buffer = (char *)malloc(size + 1);
-  if (fread(buffer, 1, size, fp) != 1) {
-    free(buffer);
-    fclose(fp);
-    return new_atom_error(input, "could not slurp '%s' - short or failed read",
-                          input->value.string.ptr);
-  }
   fclose(fp);
-
-  buffer[size] = '\0';
-
-  union atom_value value = {.string = {.ptr = buffer, .len = size}};
-  return new_atom(ATOM_TYPE_STRING, value);
+  free(path);
+  return result;
 }
 
 struct atom *primitive_read_all(struct atom *args, struct environment *env) {
   (void)env;
 
-  if (!args || args->type != ATOM_TYPE_CONS || !args->value.cons.car) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS || !atom_cons(args)->car) {
     return new_atom_error(args, "Error: 'read-all' requires one argument");
   }
 
   struct atom *input = car(args);
-  if (input->type != ATOM_TYPE_STRING) {
+  if (atom_type_of(input) != ATOM_TYPE_STRING) {
     return new_atom_error(input, "Error: 'read-all' argument must be a string");
   }
 
-  struct source_file *source = source_file_new(input->value.string.ptr);
+  char *path = atom_string_dup(input);
+  struct source_file *source = source_file_new(path);
   if (!source) {
-    return new_atom_error(input, "Error: could not open file '%s'", input->value.string.ptr);
+    struct atom *error = new_atom_error(input, "Error: could not open file '%s'", path);
+    free(path);
+    return error;
   }
 
   struct atom *head = NULL;
@@ -481,9 +525,9 @@ struct atom *primitive_read_all(struct atom *args, struct environment *env) {
   while (!source_file_eof(source)) {
     struct atom *result = read_atom(source);
     if (!result) {
-      struct atom *error =
-          new_atom_error(input, "Error: could not read from file '%s'", input->value.string.ptr);
+      struct atom *error = new_atom_error(input, "Error: could not read from file '%s'", path);
       source_file_free(source);
+      free(path);
       return error;
     }
 
@@ -492,12 +536,14 @@ struct atom *primitive_read_all(struct atom *args, struct environment *env) {
       head = cons;
       tail = head;
     } else {
-      tail->value.cons.cdr = cons;
+      atom_cons(tail)->cdr = cons;
+      gc_write_barrier(tail);
       tail = cons;
     }
   }
 
   source_file_free(source);
+  free(path);
 
   if (!head) {
     return atom_nil();
@@ -511,7 +557,7 @@ struct atom *primitive_read_line(struct atom *args, struct environment *env) {
   (void)env;
 
   // read a single line from stdin
-  char *buffer = (char *)malloc(1024);
+  char *buffer = string_buffer_new(1024);
   if (!buffer) {
     return new_atom_error(NULL, "Error: could not allocate memory for reading line");
   }
@@ -528,12 +574,445 @@ struct atom *primitive_read_line(struct atom *args, struct environment *env) {
     buffer[at++] = c;
     if (at >= (sz - 1)) {
       sz *= 2;
-      buffer = (char *)realloc(buffer, sz);
+      buffer = string_buffer_resize(buffer, sz);
+    }
+  }
+
+  return new_string_owned(ATOM_TYPE_STRING, buffer, at);
+}
+
+struct atom *primitive_substring(struct atom *args, struct environment *env) {
+  (void)env;
+
+  if (!is_cons(args) || !is_string(car(args)) || !is_cons(cdr(args)) || !is_int(car(cdr(args)))) {
+    return new_atom_error(args, "Error: 'substring' requires a string and a start index");
+  }
+
+  struct atom *string = car(args);
+  struct atom *rest = cdr(cdr(args));
+  int64_t start = atom_int(car(cdr(args)));
+  int64_t end = (int64_t)string->value.string.len;
+
+  if (is_cons(rest)) {
+    if (!is_int(car(rest)) || cdr(rest) != atom_nil()) {
+      return new_atom_error(args, "Error: 'substring' end index must be an integer");
+    }
+    end = atom_int(car(rest));
+  } else if (rest != atom_nil()) {
+    return new_atom_error(args, "Error: 'substring' requires a string and a start index");
+  }
+
+  if (start < 0 || end < start || end > (int64_t)string->value.string.len) {
+    return new_atom_error(args, "Error: 'substring' range %ld-%ld is out of bounds for length %zu",
+                          start, end, string->value.string.len);
+  }
+
+  return new_substring(string, start, end - start);
+}
+
+// Checks the vector and index arguments shared by vector-ref and vector-set!, returning an error if
+// they're invalid or NULL otherwise.
+static struct atom *check_vector_index(struct atom *args, const char *name, size_t *index) {
+  if (!is_cons(args) || !is_vector(car(args)) || !is_cons(cdr(args)) || !is_int(car(cdr(args)))) {
+    return new_atom_error(args, "Error: '%s' requires a vector and an index", name);
+  }
+
+  struct atom *vector = car(args);
+  int64_t i = atom_int(car(cdr(args)));
+  if (i < 0 || (uint64_t)i >= vector->value.vector.len) {
+    return new_atom_error(args, "Error: '%s' index %ld is out of bounds for length %zu", name, i,
+                          vector->value.vector.len);
+  }
+
+  *index = (size_t)i;
+  return NULL;
+}
+
+struct atom *primitive_make_vector(struct atom *args, struct environment *env) {
+  (void)env;
+
+  if (!is_cons(args) || !is_int(car(args)) || atom_int(car(args)) < 0) {
+    return new_atom_error(args, "Error: 'make-vector' requires a non-negative length");
+  }
+
+  struct atom *fill = NULL;
+  if (is_cons(cdr(args))) {
+    if (cdr(cdr(args)) != atom_nil()) {
+      return new_atom_error(args, "Error: 'make-vector' takes a length and an optional fill value");
+    }
+    fill = car(cdr(args));
+  }
+
+  return new_vector(atom_int(car(args)), fill);
+}
+
+struct atom *primitive_vector(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *vector = new_vector(0, NULL);
+  for (; is_cons(args); args = cdr(args)) {
+    struct atom *error = vector_push(vector, car(args));
+    if (is_error(error)) {
+      return error;
+    }
+  }
+
+  return vector;
+}
+
+struct atom *primitive_vector_ref(struct atom *args, struct environment *env) {
+  (void)env;
+
+  size_t index = 0;
+  struct atom *error = check_vector_index(args, "vector-ref", &index);
+  if (error) {
+    return error;
+  }
+
+  if (cdr(cdr(args)) != atom_nil()) {
+    return new_atom_error(args, "Error: 'vector-ref' requires exactly two arguments");
+  }
+
+  return car(args)->value.vector.items[index];
+}
+
+struct atom *primitive_vector_set(struct atom *args, struct environment *env) {
+  (void)env;
+
+  size_t index = 0;
+  struct atom *error = check_vector_index(args, "vector-set!", &index);
+  if (error) {
+    return error;
+  }
+
+  struct atom *rest = cdr(cdr(args));
+  if (!is_cons(rest) || cdr(rest) != atom_nil()) {
+    return new_atom_error(args, "Error: 'vector-set!' requires a vector, an index and a value");
+  }
+
+  struct atom *vector = car(args);
+  vector->value.vector.items[index] = car(rest);
+  gc_write_barrier(vector);
+
+  return car(rest);
+}
+
+struct atom *primitive_vector_length(struct atom *args, struct environment *env) {
+  (void)env;
+
+  if (!is_cons(args) || !is_vector(car(args)) || cdr(args) != atom_nil()) {
+    return new_atom_error(args, "Error: 'vector-length' requires exactly one vector");
+  }
+
+  return new_int((int64_t)car(args)->value.vector.len);
+}
+
+struct atom *primitive_vector_push(struct atom *args, struct environment *env) {
+  (void)env;
+
+  if (!is_cons(args) || !is_vector(car(args)) || !is_cons(cdr(args)) ||
+      cdr(cdr(args)) != atom_nil()) {
+    return new_atom_error(args, "Error: 'vector-push!' requires a vector and a value");
+  }
+
+  return vector_push(car(args), car(cdr(args)));
+}
+
+// Checks the table and key arguments shared by the table primitives, returning an error if they're
+// invalid or NULL otherwise.
+static struct atom *check_table_key(struct atom *args, const char *name) {
+  if (!is_cons(args) || !is_table(car(args)) || !is_cons(cdr(args))) {
+    return new_atom_error(args, "Error: '%s' requires a table and a key", name);
+  }
+
+  if (!table_key_valid(car(cdr(args)))) {
+    return new_atom_error(car(cdr(args)),
+                          "Error: '%s' key must be a symbol, keyword, integer or string", name);
+  }
+
+  return NULL;
+}
+
+struct atom *primitive_make_table(struct atom *args, struct environment *env) {
+  (void)env;
+
+  if (args != atom_nil()) {
+    return new_atom_error(args, "Error: 'make-table' takes no arguments");
+  }
+
+  return new_table();
+}
+
+struct atom *primitive_table_get(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_table_key(args, "table-get");
+  if (error) {
+    return error;
+  }
+
+  struct atom *rest = cdr(cdr(args));
+  struct atom *fallback = atom_nil();
+  if (is_cons(rest)) {
+    if (cdr(rest) != atom_nil()) {
+      return new_atom_error(args, "Error: 'table-get' takes a table, a key and a default");
+    }
+    fallback = car(rest);
+  }
+
+  struct atom *value = table_get(car(args), car(cdr(args)));
+  return value ? value : fallback;
+}
+
+struct atom *primitive_table_put(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_table_key(args, "table-put!");
+  if (error) {
+    return error;
+  }
+
+  struct atom *rest = cdr(cdr(args));
+  if (!is_cons(rest) || cdr(rest) != atom_nil()) {
+    return new_atom_error(args, "Error: 'table-put!' requires a table, a key and a value");
+  }
+
+  table_put(car(args), car(cdr(args)), car(rest));
+  return car(rest);
+}
+
+struct atom *primitive_table_remove(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_table_key(args, "table-remove!");
+  if (error) {
+    return error;
+  }
+
+  if (cdr(cdr(args)) != atom_nil()) {
+    return new_atom_error(args, "Error: 'table-remove!' requires exactly a table and a key");
+  }
+
+  return table_remove(car(args), car(cdr(args))) ? atom_true() : atom_nil();
+}
+
+struct atom *primitive_table_count(struct atom *args, struct environment *env) {
+  (void)env;
+
+  if (!is_cons(args) || !is_table(car(args)) || cdr(args) != atom_nil()) {
+    return new_atom_error(args, "Error: 'table-count' requires exactly one table");
+  }
+
+  return new_int((int64_t)car(args)->value.table.count);
+}
+
+struct atom *primitive_table_entries(struct atom *args, struct environment *env) {
+  (void)env;
+
+  if (!is_cons(args) || !is_table(car(args)) || cdr(args) != atom_nil()) {
+    return new_atom_error(args, "Error: 'table-entries' requires exactly one table");
+  }
+
+  return table_entries(car(args));
+}
+
+// Parses the :int or :float keyword naming an array's element type. Returns 0 if it's neither.
+static int array_element_type(struct atom *keyword, enum AtomType *element_type) {
+  if (keyword == intern(":int", 1)) {
+    *element_type = ATOM_TYPE_INT;
+  } else if (keyword == intern(":float", 1)) {
+    *element_type = ATOM_TYPE_FLOAT;
+  } else {
+    return 0;
+  }
+
+  return 1;
+}
+
+// Checks the array and index arguments shared by array-ref and array-set!, returning an error if
+// they're invalid or NULL otherwise.
+static struct atom *check_array_index(struct atom *args, const char *name, size_t *index) {
+  if (!is_cons(args) || !is_array(car(args)) || !is_cons(cdr(args)) || !is_int(car(cdr(args)))) {
+    return new_atom_error(args, "Error: '%s' requires an array and an index", name);
+  }
+
+  struct atom *array = car(args);
+  int64_t i = atom_int(car(cdr(args)));
+  if (i < 0 || (uint64_t)i >= array->value.array.len) {
+    return new_atom_error(args, "Error: '%s' index %ld is out of bounds for length %zu", name, i,
+                          array->value.array.len);
+  }
+
+  *index = (size_t)i;
+  return NULL;
+}
+
+// Checks that args are exactly one array (or two, if pair is set), returning an error if not.
+static struct atom *check_array_args(struct atom *args, const char *name, int pair) {
+  struct atom *rest = cdr(args);
+  if (!is_cons(args) || !is_array(car(args)) ||
+      (pair && (!is_cons(rest) || !is_array(car(rest)) || cdr(rest) != atom_nil())) ||
+      (!pair && rest != atom_nil())) {
+    return new_atom_error(args, "Error: '%s' requires %s", name,
+                          pair ? "exactly two arrays" : "exactly one array");
+  }
+
+  return NULL;
+}
+
+struct atom *primitive_make_array(struct atom *args, struct environment *env) {
+  (void)env;
+
+  enum AtomType element_type;
+  if (!is_cons(args) || !array_element_type(car(args), &element_type) || !is_cons(cdr(args)) ||
+      !is_int(car(cdr(args))) || atom_int(car(cdr(args))) < 0 || cdr(cdr(args)) != atom_nil()) {
+    return new_atom_error(args, "Error: 'make-array' requires :int or :float and a length");
+  }
+
+  return new_array(element_type, atom_int(car(cdr(args))));
+}
+
+struct atom *primitive_array(struct atom *args, struct environment *env) {
+  (void)env;
+
+  enum AtomType element_type;
+  if (!is_cons(args) || !array_element_type(car(args), &element_type)) {
+    return new_atom_error(args, "Error: 'array' requires :int or :float and the elements");
+  }
+
+  size_t len = 0;
+  for (struct atom *rest = cdr(args); is_cons(rest); rest = cdr(rest)) {
+    ++len;
+  }
+
+  struct atom *array = new_array(element_type, len);
+  if (is_error(array)) {
+    return array;
+  }
+
+  size_t index = 0;
+  for (struct atom *rest = cdr(args); is_cons(rest); rest = cdr(rest)) {
+    struct atom *result = array_set(array, index++, car(rest));
+    if (is_error(result)) {
+      return result;
+    }
+  }
+
+  return array;
+}
+
+struct atom *primitive_array_ref(struct atom *args, struct environment *env) {
+  (void)env;
+
+  size_t index = 0;
+  struct atom *error = check_array_index(args, "array-ref", &index);
+  if (error) {
+    return error;
+  }
+
+  if (cdr(cdr(args)) != atom_nil()) {
+    return new_atom_error(args, "Error: 'array-ref' requires exactly two arguments");
+  }
+
+  return array_ref(car(args), index);
+}
+
+struct atom *primitive_array_set(struct atom *args, struct environment *env) {
+  (void)env;
+
+  size_t index = 0;
+  struct atom *error = check_array_index(args, "array-set!", &index);
+  if (error) {
+    return error;
+  }
+
+  struct atom *rest = cdr(cdr(args));
+  if (!is_cons(rest) || cdr(rest) != atom_nil()) {
+    return new_atom_error(args, "Error: 'array-set!' requires an array, an index and a value");
+  }
+
+  return array_set(car(args), index, car(rest));
+}
+
+struct atom *primitive_array_length(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_array_args(args, "array-length", 0);
+  return error ? error : new_int((int64_t)car(args)->value.array.len);
+}
+
+struct atom *primitive_array_add(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_array_args(args, "array-add", 1);
+  return error ? error : array_add(car(args), car(cdr(args)));
+}
+
+struct atom *primitive_array_mul(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_array_args(args, "array-mul", 1);
+  return error ? error : array_mul(car(args), car(cdr(args)));
+}
+
+struct atom *primitive_array_dot(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_array_args(args, "array-dot", 1);
+  return error ? error : array_dot(car(args), car(cdr(args)));
+}
+
+struct atom *primitive_array_sum(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_array_args(args, "array-sum", 0);
+  return error ? error : array_sum(car(args));
+}
+
+struct atom *primitive_array_min(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_array_args(args, "array-min", 0);
+  return error ? error : array_min(car(args));
+}
+
+struct atom *primitive_array_max(struct atom *args, struct environment *env) {
+  (void)env;
+
+  struct atom *error = check_array_args(args, "array-max", 0);
+  return error ? error : array_max(car(args));
+}
+
+struct atom *primitive_array_map(struct atom *args, struct environment *env) {
+  if (!is_cons(args) || !is_primitive(car(args)) || !is_cons(cdr(args)) ||
+      !is_array(car(cdr(args))) || cdr(cdr(args)) != atom_nil()) {
+    return new_atom_error(args, "Error: 'array-map' requires a primitive function and an array");
+  }
+
+  struct atom *fn = car(args);
+  struct atom *array = car(cdr(args));
+  struct atom *result = new_array(array->value.array.element_type, array->value.array.len);
+  if (is_error(result)) {
+    return result;
+  }
+
+  struct atom *error = NULL;
+
+  // some primitives (e.g. eval) can reach a GC safe point
+  GC_PUSH_FRAME(frame, GC_ROOT(fn), GC_ROOT(array), GC_ROOT(result));
+
+  for (size_t i = 0; i < array->value.array.len && !error; ++i) {
+    struct atom *value = apply(fn, new_cons(array_ref(array, i), atom_nil()), env);
+    if (is_error(value)) {
+      error = value;
+    } else {
+      struct atom *stored = array_set(result, i, value);
+      error = is_error(stored) ? stored : NULL;
     }
   }
 
-  union atom_value value = {.string = {.ptr = buffer, .len = at}};
-  return new_atom(ATOM_TYPE_STRING, value);
+  GC_POP_FRAME(frame);
+  return error ? error : result;
 }
 
 void init_primitives(struct environment *env) {
@@ -566,4 +1045,50 @@ void init_primitives(struct environment *env) {
   env_bind(env, intern("read-all", 0), primitive_function(primitive_read_all));
   // (read-line) - reads a single line from stdin
   env_bind(env, intern("read-line", 0), primitive_function(primitive_read_line));
+  // (substring str start [end]) - returns part of a string, sharing its buffer
+  env_bind(env, intern("substring", 0), primitive_function(primitive_substring));
+
+  // (make-vector n [fill]) - returns a vector of n elements, all fill (or nil)
+  env_bind(env, intern("make-vector", 0), primitive_function(primitive_make_vector));
+  // (vector ...) - returns a vector of its arguments
+  env_bind(env, intern("vector", 0), primitive_function(primitive_vector));
+  // (vector-ref v i) - returns the element at index i, in constant time
+  env_bind(env, intern("vector-ref", 0), primitive_function(primitive_vector_ref));
+  // (vector-set! v i x) - replaces the element at index i with x, returning x
+  env_bind(env, intern("vector-set!", 0), primitive_function(primitive_vector_set));
+  // (vector-length v) - returns the number of elements in the vector
+  env_bind(env, intern("vector-length", 0), primitive_function(primitive_vector_length));
+  // (vector-push! v x) - appends x to the vector, returning the vector
+  env_bind(env, intern("vector-push!", 0), primitive_function(primitive_vector_push));
+
+  // (make-table) - returns an empty hash table, keyed by symbols, keywords, integers or strings
+  env_bind(env, intern("make-table", 0), primitive_function(primitive_make_table));
+  // (table-get t k [default]) - returns the value stored under k, or default (or nil)
+  env_bind(env, intern("table-get", 0), primitive_function(primitive_table_get));
+  // (table-put! t k v) - stores v under k, returning v
+  env_bind(env, intern("table-put!", 0), primitive_function(primitive_table_put));
+  // (table-remove! t k) - removes k, returning t if it was present
+  env_bind(env, intern("table-remove!", 0), primitive_function(primitive_table_remove));
+  // (table-count t) - returns the number of entries
+  env_bind(env, intern("table-count", 0), primitive_function(primitive_table_count));
+  // (table-entries t) - returns the entries as a list of (key . value) pairs, to iterate over
+  env_bind(env, intern("table-entries", 0), primitive_function(primitive_table_entries));
+
+  // (make-array :int|:float n) - returns an unboxed array of n zeros
+  env_bind(env, intern("make-array", 0), primitive_function(primitive_make_array));
+  // (array :int|:float ...) - returns an unboxed array of its arguments
+  env_bind(env, intern("array", 0), primitive_function(primitive_array));
+  env_bind(env, intern("array-ref", 0), primitive_function(primitive_array_ref));
+  env_bind(env, intern("array-set!", 0), primitive_function(primitive_array_set));
+  env_bind(env, intern("array-length", 0), primitive_function(primitive_array_length));
+  // (array-add a b), (array-mul a b) - elementwise arithmetic, returning a new array
+  env_bind(env, intern("array-add", 0), primitive_function(primitive_array_add));
+  env_bind(env, intern("array-mul", 0), primitive_function(primitive_array_mul));
+  // (array-sum a), (array-dot a b), (array-min a), (array-max a) - reductions
+  env_bind(env, intern("array-sum", 0), primitive_function(primitive_array_sum));
+  env_bind(env, intern("array-dot", 0), primitive_function(primitive_array_dot));
+  env_bind(env, intern("array-min", 0), primitive_function(primitive_array_min));
+  env_bind(env, intern("array-max", 0), primitive_function(primitive_array_max));
+  // (array-map f a) - applies a primitive function to each element, returning a new array
+  env_bind(env, intern("array-map", 0), primitive_function(primitive_array_map));
 }
@@ -3,6 +3,7 @@
 #include <stdio.h>
 
 #include "atom.h"
+#include "bignum.h"
 
 static int print_list(char *buffer, size_t buffer_size, struct atom *atom, int readably) {
   if (!is_cons(atom)) {
@@ -12,24 +13,59 @@ static int print_list(char *buffer, size_t buffer_size, struct atom *atom, int r
   size_t offset = 0;
   offset += snprintf(buffer + offset, buffer_size - offset, "(");
 
-  while (atom && atom->type == ATOM_TYPE_CONS) {
+  while (atom && atom_type_of(atom) == ATOM_TYPE_CONS) {
     offset += print_str(buffer + offset, buffer_size - offset, car(atom), readably);
+    if (offset >= buffer_size) {
+      // Output is truncated, don't walk the rest of a (possibly very long) list.
+      return (int)offset;
+    }
 
     atom = cdr(atom);
-    if (atom && atom->type == ATOM_TYPE_CONS) {
+    if (atom && atom_type_of(atom) == ATOM_TYPE_CONS) {
       offset += snprintf(buffer + offset, buffer_size - offset, " ");
     }
   }
 
-  if (atom && atom->type != ATOM_TYPE_NIL) {
+  if (atom && atom_type_of(atom) != ATOM_TYPE_NIL) {
     offset += snprintf(buffer + offset, buffer_size - offset, " . ");
+    if (offset >= buffer_size) {
+      return (int)offset;
+    }
+
     offset += print_str(buffer + offset, buffer_size - offset, atom, readably);
   }
 
+  if (offset >= buffer_size) {
+    return (int)offset;
+  }
+
   offset += snprintf(buffer + offset, buffer_size - offset, ")");
   return (int)offset;
 }
 
+static int print_vector(char *buffer, size_t buffer_size, struct atom *atom, int readably) {
+  size_t offset = 0;
+  offset += snprintf(buffer + offset, buffer_size - offset, "[");
+
+  for (size_t i = 0; i < atom->value.vector.len; ++i) {
+    if (i) {
+      offset += snprintf(buffer + offset, buffer_size - offset, " ");
+    }
+
+    if (offset < buffer_size) {
+      offset +=
+          print_str(buffer + offset, buffer_size - offset, atom->value.vector.items[i], readably);
+    }
+    if (offset >= buffer_size) {
+      // Output is truncated, don't print the rest of a (possibly very long) vector.
+      return (int)offset;
+    }
+  }
+
+  offset += snprintf(buffer + offset, buffer_size - offset, "]");
+  return (int)offset;
+}
+
 void print(FILE *fp, struct atom *atom, int readably) {
   char *buffer = malloc(1024);
   print_str(buffer, 1024, atom, readably);
@@ -74,7 +110,7 @@ const char *escape_string(const char *str, size_t len) {
   escaped[j++] = '"';
   escaped[j] = '\0';
 
-  fprintf(stderr, "escape '%s' -> '%s'\n", str, escaped);
+  fprintf(stderr, "escape '%.*s' -> '%s'\n", (int)len, str, escaped);
 
   return escaped;
 }
@@ -84,12 +120,15 @@ int print_str(char *buffer, size_t buffer_size, struct atom *atom, int readably)
     return snprintf(buffer, buffer_size, "nil");
   }
 
-  switch (atom->type) {
+  switch (atom_type_of(atom)) {
     case ATOM_TYPE_INT:
-      return snprintf(buffer, buffer_size, "%ld", atom->value.ivalue);
+      return snprintf(buffer, buffer_size, "%ld", atom_int(atom));
+      break;
+    case ATOM_TYPE_BIGNUM:
+      return bignum_print(buffer, buffer_size, atom);
       break;
     case ATOM_TYPE_FLOAT:
-      return snprintf(buffer, buffer_size, "%f", atom->value.fvalue);
+      return snprintf(buffer, buffer_size, "%f", atom_float(atom));
       break;
     case ATOM_TYPE_STRING:
       if (!readably) {
@@ -100,11 +139,23 @@ int print_str(char *buffer, size_t buffer_size, struct atom *atom, int readably)
         return result;
       }
 
-      return snprintf(buffer, buffer_size, "\"%s\"", atom->value.string.ptr);
+      return snprintf(buffer, buffer_size, "\"%.*s\"", (int)atom->value.string.len,
+                      atom->value.string.ptr);
       break;
     case ATOM_TYPE_CONS:
       return print_list(buffer, buffer_size, atom, readably);
       break;
+    case ATOM_TYPE_VECTOR:
+      return print_vector(buffer, buffer_size, atom, readably);
+      break;
+    case ATOM_TYPE_TABLE:
+      return snprintf(buffer, buffer_size, "<table %zu>", atom->value.table.count);
+      break;
+    case ATOM_TYPE_ARRAY:
+      return snprintf(buffer, buffer_size, "<array %s %zu>",
+                      atom_type_to_string(atom->value.array.element_type),
+                      atom->value.array.len);
+      break;
     case ATOM_TYPE_NIL:
       return snprintf(buffer, buffer_size, "nil");
       break;
@@ -114,6 +165,13 @@ int print_str(char *buffer, size_t buffer_size, struct atom *atom, int readably)
     case ATOM_TYPE_KEYWORD:
       return snprintf(buffer, buffer_size, "%s", atom->value.string.ptr);
       break;
+    case ATOM_TYPE_LOCAL:
+      return snprintf(buffer, buffer_size, "%s", atom->value.local.symbol->value.string.ptr);
+      break;
+    case ATOM_TYPE_SPECIAL:
+      // resolved lambda bodies hold special forms in place of the symbols that named them
+      return snprintf(buffer, buffer_size, "<special form>");
+      break;
     case ATOM_TYPE_TRUE:
       return snprintf(buffer, buffer_size, "t");
       break;
@@ -123,7 +181,7 @@ int print_str(char *buffer, size_t buffer_size, struct atom *atom, int readably)
     case ATOM_TYPE_EOF:
       break;
     default:
-      fprintf(stderr, "Unknown atom type: %d\n", atom->type);
+      fprintf(stderr, "Unknown atom type: %d\n", atom_type_of(atom));
       break;
   }
 
@@ -1,17 +1,21 @@
 #include "read.h"
 
 #include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "atom.h"
+#include "bignum.h"
 #include "clog.h"
+#include "gc.h"
 #include "intern.h"
 #include "lex.h"
 #include "log.h"
 
 static struct atom *read_list(struct lex *lex);
+static struct atom *read_vector(struct lex *lex);
 
 static void consume_whitespace(struct source_file *source) {
   char c = source_file_getc(source);
@@ -48,17 +52,16 @@ static struct atom *read_atom_lex(struct lex *lex) {
       if (isdigit(token->text[0]) || (token->text[0] == '-' && isdigit(token->text[1]))) {
         // probably an integer or float
         char *endptr;
+        errno = 0;
         long int_value = strtol(token->text, &endptr, 10);
         if (*endptr == '\0') {
-          // it's an integer
-          union atom_value value = {.ivalue = int_value};
-          return new_atom(ATOM_TYPE_INT, value);
+          // it's an integer, or a bignum if it's too large for a long
+          return errno == ERANGE ? bignum_from_string(token->text) : new_int(int_value);
         } else {
           // try to parse as float
           double float_value = strtod(token->text, &endptr);
           if (*endptr == '\0') {
-            union atom_value value = {.fvalue = float_value};
-            return new_atom(ATOM_TYPE_FLOAT, value);
+            return new_float(float_value);
           } else {
             return new_atom_error(NULL, "could not parse number '%s'", token->text);
           }
@@ -73,15 +76,19 @@ static struct atom *read_atom_lex(struct lex *lex) {
 
       return intern(token->text, token->text[0] == ':');
     case TOKEN_STRING: {
-      union atom_value value = {.string = {.ptr = strdup(token->text), .len = token->length}};
-      clog_debug(CLOG(LOGGER_READ), "read string: '%s'", value.string.ptr);
-      return new_atom(ATOM_TYPE_STRING, value);
+      struct atom *atom = new_string(ATOM_TYPE_STRING, token->text, token->length);
+      clog_debug(CLOG(LOGGER_READ), "read string: '%s'", atom->value.string.ptr);
+      return atom;
     }
     case TOKEN_LPAREN: {
       return read_list(lex);
     } break;
     case TOKEN_RPAREN:
       return new_atom_error(NULL, "unexpected right parenthesis");
+    case TOKEN_LBRACKET:
+      return read_vector(lex);
+    case TOKEN_RBRACKET:
+      return new_atom_error(NULL, "unexpected right bracket");
     case TOKEN_QUOTE: {
       struct atom *atom = read_atom_lex(lex);
       if (is_error(atom)) {
@@ -125,14 +132,19 @@ struct atom *read_atom(struct source_file *source) {
 static struct atom *read_list(struct lex *lex) {
   // LPAREN already consumed before this call
 
-  struct atom *head = NULL;
-  struct atom *prev = NULL;
-
-  int dotted = 0;
+  // The elements are collected first and the cells allocated together at the end, so that the
+  // list's cells sit next to each other in the heap. Reading never reaches a GC safe point, so the
+  // collected atoms don't need to be rooted.
+  struct atom **items = NULL;
+  size_t count = 0;
+  size_t capacity = 0;
+  struct atom *tail = NULL;
+  struct atom *result = NULL;
 
-  while (1) {
+  while (!result) {
     struct token *token = lex_peek_token(lex);
 
+    int dotted = 0;
     if (token->type == TOKEN_RPAREN) {
       // consume it
       lex_next_token(lex);
@@ -143,50 +155,83 @@ static struct atom *read_list(struct lex *lex) {
       // consume the dot so the atom read collects the correct next atom instead of the dot
       lex_next_token(lex);
     } else if (token->type == TOKEN_ERROR) {
-      return new_atom_error(NULL, "lexer error: %s", token->text);
+      result = new_atom_error(NULL, "lexer error: %s", token->text);
+      break;
     } else if (token->type == TOKEN_EOF) {
-      return new_atom_error(NULL, "unexpected end of file while reading list");
+      result = new_atom_error(NULL, "unexpected end of file while reading list");
+      break;
     }
 
     // this will actually consume the token now
     struct atom *atom = read_atom_lex(lex);
     if (is_error(atom)) {
-      return atom;
+      result = atom;
+      break;
     }
 
-    if (dotted) {
-      if (!prev) {
-        return new_atom_error(atom, "cannot have dotted pair without a previous cons cell");
-      }
-
-      if (!is_nil(cdr(prev))) {
-        return new_atom_error(atom, "cannot have more than one dotted pair in a list");
+    if (!dotted) {
+      if (count == capacity) {
+        capacity = capacity ? capacity * 2 : 8;
+        items = realloc(items, capacity * sizeof(*items));
       }
 
-      prev->value.cons.cdr = atom;
+      items[count++] = atom;
+      continue;
+    }
 
-      token = lex_next_token(lex);  // consume the closing parenthesis
-      if (token->type != TOKEN_RPAREN) {
-        return new_atom_error(atom, "expected ')', got '%s'", token->text);
-      }
+    if (!count) {
+      result = new_atom_error(atom, "cannot have dotted pair without a previous cons cell");
+      break;
+    }
 
+    token = lex_next_token(lex);  // consume the closing parenthesis
+    if (token->type != TOKEN_RPAREN) {
+      result = new_atom_error(atom, "expected ')', got '%s'", token->text);
       break;
     }
 
-    struct atom *cons = new_cons(atom, NULL);
+    tail = atom;
+    break;
+  }
+
+  if (!result) {
+    result = new_list(items, count, tail);
+  }
+
+  free(items);
+  return result;
+}
 
-    if (!head) {
-      head = cons;  // first cons cell becomes the head of the list
-    } else {
-      prev->value.cons.cdr = cons;  // link the previous cons cell to the new one
+static struct atom *read_vector(struct lex *lex) {
+  // LBRACKET already consumed before this call
+
+  struct atom *vector = new_vector(0, NULL);
+
+  while (1) {
+    struct token *token = lex_peek_token(lex);
+
+    if (token->type == TOKEN_RBRACKET) {
+      // consume it
+      lex_next_token(lex);
+      break;
+    } else if (token->type == TOKEN_DOT) {
+      return new_atom_error(NULL, "unexpected dot in vector");
+    } else if (token->type == TOKEN_ERROR) {
+      return new_atom_error(NULL, "lexer error: %s", token->text);
+    } else if (token->type == TOKEN_EOF) {
+      return new_atom_error(NULL, "unexpected end of file while reading vector");
     }
 
-    prev = cons;  // update the previous pointer to the current cons cell
-  }
+    struct atom *atom = read_atom_lex(lex);
+    if (is_error(atom)) {
+      return atom;
+    }
 
-  if (!head) {
-    head = atom_nil();
+    struct atom *error = vector_push(vector, atom);
+    if (is_error(error)) {
+      return error;
+    }
   }
 
-  return head;
+  return vector;
 }
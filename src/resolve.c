@@ -0,0 +1,278 @@
+#include "resolve.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "atom.h"
+#include "env.h"
+#include "intern.h"
+#include "special.h"
+
+// The variables of a lambda or let that's being resolved, in slot order, and those of the lambdas
+// and lets around it.
+struct scope {
+  struct scope *parent;
+  struct atom *vars;  // a lambda's parameter list or a let's binding list
+  int is_let;         // whether each element of vars is a (name value) binding
+};
+
+typedef struct atom *(*ResolveFunction)(struct atom *form, struct scope *scope,
+                                        struct environment *env);
+
+static struct atom *resolve(struct atom *form, struct scope *scope, struct environment *env);
+
+// Returns the variable an element of a scope's vars binds, which may not be a valid one (the
+// lambda or let reports that when it's evaluated).
+static struct atom *scope_var(struct scope *scope, struct atom *element) {
+  return scope->is_let ? (is_cons(element) ? car(element) : NULL) : element;
+}
+
+// Returns a LOCAL for symbol if it's the variable of an enclosing lambda or let, or NULL.
+static struct atom *resolve_symbol(struct atom *symbol, struct scope *scope) {
+  for (uint32_t depth = 0; scope; scope = scope->parent, ++depth) {
+    uint32_t slot = 0;
+    for (struct atom *vars = scope->vars; is_cons(vars); vars = cdr(vars), ++slot) {
+      if (scope_var(scope, car(vars)) == symbol) {
+        union atom_value value = {.local = {.symbol = symbol, .depth = depth, .slot = slot}};
+        return new_atom(ATOM_TYPE_LOCAL, value);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+// Returns form itself if its car and cdr are unchanged, so that resolving only copies the parts
+// of a body that refer to variables.
+static struct atom *rebuild(struct atom *form, struct atom *new_car, struct atom *new_cdr) {
+  if (new_car == car(form) && new_cdr == cdr(form)) {
+    return form;
+  }
+
+  return new_cons(new_car, new_cdr);
+}
+
+// Collects the elements of a list as they're resolved, to copy the list only as far as its last
+// changed element and share the rest.
+struct resolved_list {
+  struct atom **items;
+  size_t count;
+  size_t capacity;
+  size_t changed;     // elements up to and including the last one that changed
+  struct atom *rest;  // what follows the last changed element
+};
+
+static void resolved_list_add(struct resolved_list *list, struct atom *cell, struct atom *item) {
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity ? list->capacity * 2 : 8;
+    list->items = realloc(list->items, list->capacity * sizeof(*list->items));
+  }
+
+  list->items[list->count++] = item;
+  if (item != car(cell)) {
+    list->changed = list->count;
+    list->rest = cdr(cell);
+  }
+}
+
+// Returns the resolved copy of original (or original itself if nothing changed), and frees the
+// list's items.
+static struct atom *resolved_list_finish(struct resolved_list *list, struct atom *original) {
+  struct atom *result = original;
+  if (list->changed) {
+    result = new_list(list->items, list->changed, list->rest);
+  }
+
+  free(list->items);
+  return result;
+}
+
+// Applies fn to every element of a list. The list is walked in a loop rather than recursively,
+// so that a long one (say a literal list or a long begin) doesn't use up the C stack.
+static struct atom *resolve_map(struct atom *list, ResolveFunction fn, struct scope *scope,
+                                struct environment *env) {
+  struct resolved_list resolved = {NULL, 0, 0, 0, NULL};
+  for (struct atom *cell = list; is_cons(cell); cell = cdr(cell)) {
+    resolved_list_add(&resolved, cell, fn(car(cell), scope, env));
+  }
+
+  return resolved_list_finish(&resolved, list);
+}
+
+// Resolves every element of a list of expressions.
+static struct atom *resolve_each(struct atom *list, struct scope *scope,
+                                 struct environment *env) {
+  return resolve_map(list, resolve, scope, env);
+}
+
+// Returns 1 if a quasiquote template is a nested quasiquote or an unquote, rather than a list
+// whose elements are templates themselves.
+static int is_quasiquote_form(struct atom *atom) {
+  struct atom *head = car(atom);
+  return (head == intern("quasiquote", 0) || head == intern("unquote", 0)) && is_cons(cdr(atom));
+}
+
+// Resolves the unquoted expressions of a quasiquote template, following quasiquote's nesting.
+static struct atom *resolve_quasiquote(struct atom *atom, struct scope *scope,
+                                       struct environment *env, int depth) {
+  if (!is_cons(atom)) {
+    return atom;
+  }
+
+  struct atom *head = car(atom);
+  if (is_quasiquote_form(atom)) {
+    struct atom *arg = car(cdr(atom));
+    if (head == intern("quasiquote", 0)) {
+      arg = resolve_quasiquote(arg, scope, env, depth + 1);
+    } else if (depth == 0) {
+      arg = resolve(arg, scope, env);
+    } else {
+      arg = resolve_quasiquote(arg, scope, env, depth - 1);
+    }
+
+    return rebuild(atom, head, rebuild(cdr(atom), arg, cdr(cdr(atom))));
+  }
+
+  // The elements are resolved in a loop, up to the end of the list or an unquote in dotted
+  // position, (a . ,b) being (a unquote b).
+  struct resolved_list resolved = {NULL, 0, 0, 0, NULL};
+  struct atom *cell = atom;
+  do {
+    resolved_list_add(&resolved, cell, resolve_quasiquote(car(cell), scope, env, depth));
+    cell = cdr(cell);
+  } while (is_cons(cell) && !is_quasiquote_form(cell));
+
+  struct atom *tail = resolve_quasiquote(cell, scope, env, depth);
+  if (tail != cell) {
+    resolved.changed = resolved.count;
+    resolved.rest = tail;
+  }
+
+  return resolved_list_finish(&resolved, atom);
+}
+
+// Resolves params body... (the arguments of a lambda, after a defun's name).
+static struct atom *resolve_lambda_args(struct atom *args, struct scope *scope,
+                                        struct environment *env) {
+  if (!is_cons(args) || !is_cons(cdr(args))) {
+    return args;
+  }
+
+  struct scope inner = {.parent = scope, .vars = car(args), .is_let = 0};
+  struct atom *body = resolve(car(cdr(args)), &inner, env);
+  return rebuild(args, car(args), rebuild(cdr(args), body, cdr(cdr(args))));
+}
+
+// Resolves the value of one of a let's (name value) bindings.
+static struct atom *resolve_binding(struct atom *binding, struct scope *scope,
+                                    struct environment *env) {
+  if (!is_cons(binding) || !is_cons(cdr(binding))) {
+    return binding;
+  }
+
+  struct atom *value = resolve(car(cdr(binding)), scope, env);
+  return rebuild(binding, car(binding), rebuild(cdr(binding), value, cdr(cdr(binding))));
+}
+
+// Resolves ((name value)...) body... (the arguments of a let).
+static struct atom *resolve_let_args(struct atom *args, struct scope *scope,
+                                     struct environment *env) {
+  if (!is_cons(args)) {
+    return args;
+  }
+
+  // values are evaluated in the let's environment as the variables are bound, so later bindings
+  // can refer to earlier ones
+  struct scope inner = {.parent = scope, .vars = car(args), .is_let = 1};
+  struct atom *bindings = resolve_map(car(args), resolve_binding, &inner, env);
+  return rebuild(args, bindings, resolve_each(cdr(args), &inner, env));
+}
+
+// Returns the special form or macro a form's head names, or NULL if it's a function call.
+static struct atom *resolve_head(struct atom *head, struct scope *scope,
+                                 struct environment *env) {
+  if (is_special(head)) {
+    // already resolved, e.g. by the lambda this form was nested in
+    return head;
+  } else if (!is_symbol(head)) {
+    return NULL;
+  }
+
+  // a variable of an enclosing lambda or let shadows any special form or macro
+  for (; scope; scope = scope->parent) {
+    for (struct atom *vars = scope->vars; is_cons(vars); vars = cdr(vars)) {
+      if (scope_var(scope, car(vars)) == head) {
+        return NULL;
+      }
+    }
+  }
+
+  struct atom *value = env_lookup(env, head);
+  int is_macro = is_lambda(value) && (value->value.lambda.flags & ATOM_LAMBDA_FLAG_MACRO);
+  if (is_special(value) || is_macro) {
+    return value;
+  }
+
+  return NULL;
+}
+
+static struct atom *resolve(struct atom *form, struct scope *scope, struct environment *env) {
+  if (is_symbol(form) || is_local(form)) {
+    // a LOCAL here came from a macro argument, and might not be in the same place any more
+    struct atom *symbol = is_local(form) ? form->value.local.symbol : form;
+    struct atom *local = resolve_symbol(symbol, scope);
+    return local ? local : symbol;
+  } else if (!is_cons(form)) {
+    return form;
+  }
+
+  struct atom *head = car(form);
+  struct atom *args = cdr(form);
+
+  struct atom *fn = resolve_head(head, scope, env);
+  if (!fn) {
+    return resolve_each(form, scope, env);
+  } else if (is_lambda(fn)) {
+    // the macro's arguments are code it gets to see as it was written
+    return form;
+  }
+
+  switch (special_form_syntax(fn)) {
+    case SPECIAL_SYNTAX_QUOTE:
+      return form;
+    case SPECIAL_SYNTAX_QUASIQUOTE:
+      return rebuild(form, head, resolve_quasiquote(args, scope, env, 0));
+    case SPECIAL_SYNTAX_LAMBDA:
+      return new_cons(special_form_resolved(fn), resolve_lambda_args(args, scope, env));
+    case SPECIAL_SYNTAX_DEFUN:
+      if (!is_cons(args)) {
+        return form;
+      }
+      return new_cons(special_form_resolved(fn),
+                      rebuild(args, car(args), resolve_lambda_args(cdr(args), scope, env)));
+    case SPECIAL_SYNTAX_LET:
+      return new_cons(special_form_resolved(fn), resolve_let_args(args, scope, env));
+    case SPECIAL_SYNTAX_DEFINE:
+      // the name is bound or set by name, not evaluated
+      if (!is_cons(args)) {
+        return form;
+      }
+      return rebuild(form, head, rebuild(args, car(args), resolve_each(cdr(args), scope, env)));
+    case SPECIAL_SYNTAX_COND:
+      // each (test body...) clause is a list of expressions
+      return rebuild(form, head, resolve_map(args, resolve_each, scope, env));
+    case SPECIAL_SYNTAX_EXPRESSIONS:
+      return rebuild(form, head, resolve_each(args, scope, env));
+  }
+
+  return form;
+}
+
+struct atom *resolve_lambda(struct atom *params, struct atom *body, struct environment *env) {
+  struct scope scope = {.parent = NULL, .vars = params, .is_let = 0};
+  return resolve(body, &scope, env);
+}
+
+struct atom *resolve_let(struct atom *args, struct environment *env) {
+  return resolve_let_args(args, NULL, env);
+}
@@ -0,0 +1,32 @@
+#ifndef _QUANTA_RESOLVE_H
+#define _QUANTA_RESOLVE_H
+
+#include "atom.h"
+#include "env.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The resolver runs when a lambda or let is created. It rewrites each reference to one of its
+// variables (or those of the lambdas and lets it's nested in) as an ATOM_TYPE_LOCAL atom holding
+// the variable's position: how many frames up the environment chain it is, and its slot in that
+// frame. Evaluating one is then a couple of pointer loads instead of a lookup by name in every
+// frame. Anything else, such as a global or a variable defined inside a body, stays a symbol.
+//
+// Quoted data and the arguments of macro calls are left as they are. Nested lambdas and lets are
+// resolved along with the body they're in, so they aren't resolved again when they're evaluated.
+// The forms are copied rather than modified, env is only used to recognise special forms and
+// macros, and nothing is evaluated, so resolving never reaches a GC safe point.
+
+// Returns the resolved body of a lambda with the given parameters.
+struct atom *resolve_lambda(struct atom *params, struct atom *body, struct environment *env);
+
+// Returns the resolved arguments of a let, ((name value)...) body...
+struct atom *resolve_let(struct atom *args, struct environment *env);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // _QUANTA_RESOLVE_H
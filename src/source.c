@@ -14,9 +14,10 @@ struct source_file {
     } file;
 
     struct {
-      char *buf;
+      const char *buf;
       size_t buflen;
       size_t pos;
+      int is_owned;
     } memory;
   } source;
 };
@@ -36,11 +37,26 @@ struct source_file *source_file_new(const char *filename) {
 }
 
 struct source_file *source_file_str(const char *str, size_t length) {
+  if (length == 0) {
+    length = strlen(str);
+  }
+
+  char *buf = malloc(length + 1);
+  memcpy(buf, str, length);
+  buf[length] = '\0';
+
+  struct source_file *source = source_file_str_view(buf, length);
+  source->source.memory.is_owned = 1;
+  return source;
+}
+
+struct source_file *source_file_str_view(const char *str, size_t length) {
   struct source_file *source = calloc(1, sizeof(struct source_file));
   source->in_memory = 1;
-  source->source.memory.buf = strdup(str);
-  source->source.memory.buflen = length == 0 ? strlen(str) : length;
+  source->source.memory.buf = str;
+  source->source.memory.buflen = length;
   source->source.memory.pos = 0;
+  source->source.memory.is_owned = 0;
 
   return source;
 }
@@ -72,8 +88,11 @@ void source_file_ungetc(struct source_file *source, char c) {
 
       // Technically we have to actually store the character here.
       // ungetc could be used to insert a character back to the stream.
-      // Could replace this with a separate "unget" buffer if needed.
-      source->source.memory.buf[source->source.memory.pos] = c;
+      // Could replace this with a separate "unget" buffer if needed. Views never store it, as
+      // their string may be shared; callers only ever put back the character they just read.
+      if (source->source.memory.is_owned) {
+        ((char *)source->source.memory.buf)[source->source.memory.pos] = c;
+      }
     }
   } else {
     ungetc(c, source->source.file.fp);
@@ -94,7 +113,9 @@ void source_file_free(struct source_file *source) {
   }
 
   if (source->in_memory) {
-    free(source->source.memory.buf);
+    if (source->source.memory.is_owned) {
+      free((void *)source->source.memory.buf);
+    }
   } else {
     fclose(source->source.file.fp);
   }
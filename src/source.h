@@ -15,9 +15,14 @@ struct source_file *source_file_new(const char *filename);
 // Creates a new source file from stdin.
 struct source_file *source_file_stdin(void);
 
-// Creates a new source file from the given string. The string is copied.
+// Creates a new source file from the given string. The string is copied. A length of 0 reads up to
+// the string's NUL terminator.
 struct source_file *source_file_str(const char *str, size_t length);
 
+// Like source_file_str, but reads the string in place without copying it. The string must outlive
+// the source.
+struct source_file *source_file_str_view(const char *str, size_t length);
+
 char source_file_getc(struct source_file *source);
 void source_file_ungetc(struct source_file *source, char c);
 
@@ -4,8 +4,10 @@
 
 #include "atom.h"
 #include "eval.h"
+#include "gc.h"
 #include "intern.h"
 #include "log.h"
+#include "resolve.h"
 
 static struct atom *special_form(PrimitiveFunction func) {
   union atom_value value = {.primitive = func};
@@ -40,8 +42,11 @@ static struct atom *quasiquote_atom(struct atom *atom, struct environment *env,
       }
     }
 
+    // unquotes in the cdr are evaluated, which may trigger GC
     struct atom *quasi_car = quasiquote_atom(car(atom), env, depth);
+    GC_PUSH_FRAME(frame, GC_ROOT(quasi_car));
     struct atom *quasi_cdr = quasiquote_atom(cdr(atom), env, depth);
+    GC_POP_FRAME(frame);
 
     return new_cons(quasi_car, quasi_cdr);
   }
@@ -68,34 +73,47 @@ struct atom *unquote(struct atom *args, struct environment *env) {
   return new_atom_error(args, "Error: 'unquote' is only valid inside a 'quasiquote'");
 }
 
-struct atom *lambda(struct atom *args, struct environment *env) {
-  if (!args || args->type != ATOM_TYPE_CONS || !args->value.cons.car || !args->value.cons.cdr ||
-      args->value.cons.cdr->type != ATOM_TYPE_CONS) {
+// Creates a lambda, first resolving its body unless it was resolved along with an enclosing one.
+static struct atom *make_lambda(struct atom *args, struct environment *env, int resolve) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS || !atom_cons(args)->car ||
+      !atom_cons(args)->cdr || atom_type_of(atom_cons(args)->cdr) != ATOM_TYPE_CONS) {
     return new_atom_error(args, "Error: 'lambda' requires a list of parameters and a body");
   }
 
   struct atom *params = car(args);
-  if (params != atom_nil() && params->type != ATOM_TYPE_CONS) {
+  if (params != atom_nil() && atom_type_of(params) != ATOM_TYPE_CONS) {
     return new_atom_error(params, "Error: 'lambda' first argument must be a list of parameters");
   }
 
   struct atom *body = car(cdr(args));
-  if (body->type != ATOM_TYPE_CONS) {
+  if (atom_type_of(body) != ATOM_TYPE_CONS) {
     return new_atom_error(body, "Error: 'lambda' body must be a list");
   }
 
-  union atom_value value = {
-      .lambda = {.args = params, .env = clone_environment(env), .body = body}};
+  if (resolve) {
+    body = resolve_lambda(params, body, env);
+  }
+
+  // The closure shares the environment it was created in rather than a copy of it, so it sees
+  // later defines and set!s there (including its own name's, for recursion), and creating it
+  // costs the same however many variables are in scope.
+  union atom_value value = {.lambda = {.args = params, .env = env, .body = body}};
 
   return new_atom(ATOM_TYPE_LAMBDA, value);
 }
 
-// Syntax sugar for (define name (lambda args body))
-struct atom *defun(struct atom *args, struct environment *env) {
-  (void)env;
+struct atom *lambda(struct atom *args, struct environment *env) {
+  return make_lambda(args, env, 1);
+}
+
+static struct atom *lambda_resolved(struct atom *args, struct environment *env) {
+  return make_lambda(args, env, 0);
+}
 
+// Syntax sugar for (define name (lambda args body))
+static struct atom *make_defun(struct atom *args, struct environment *env, int resolve) {
   struct atom *name = car(args);
-  if (name->type != ATOM_TYPE_SYMBOL) {
+  if (atom_type_of(name) != ATOM_TYPE_SYMBOL) {
     return new_atom_error(name, "Error: 'defun' first argument must be a symbol");
   }
 
@@ -105,7 +123,7 @@ struct atom *defun(struct atom *args, struct environment *env) {
     return bound;
   }
 
-  struct atom *defn = lambda(cdr(args), env);
+  struct atom *defn = make_lambda(cdr(args), env, resolve);
   if (is_error(defn)) {
     return defn;
   }
@@ -113,15 +131,21 @@ struct atom *defun(struct atom *args, struct environment *env) {
   return env_set(env, name, defn);
 }
 
-struct atom *defmacro(struct atom *args, struct environment *env) {
-  (void)env;
+struct atom *defun(struct atom *args, struct environment *env) {
+  return make_defun(args, env, 1);
+}
 
+static struct atom *defun_resolved(struct atom *args, struct environment *env) {
+  return make_defun(args, env, 0);
+}
+
+static struct atom *make_defmacro(struct atom *args, struct environment *env, int resolve) {
   struct atom *name = car(args);
   if (!is_symbol(name)) {
     return new_atom_error(name, "Error: 'defun' first argument must be a symbol");
   }
 
-  struct atom *defn = lambda(cdr(args), env);
+  struct atom *defn = make_lambda(cdr(args), env, resolve);
   if (is_error(defn)) {
     return defn;
   }
@@ -131,11 +155,19 @@ struct atom *defmacro(struct atom *args, struct environment *env) {
   return env_bind(env, name, defn);
 }
 
+struct atom *defmacro(struct atom *args, struct environment *env) {
+  return make_defmacro(args, env, 1);
+}
+
+static struct atom *defmacro_resolved(struct atom *args, struct environment *env) {
+  return make_defmacro(args, env, 0);
+}
+
 struct atom *special_form_define(struct atom *args, struct environment *env) {
   (void)env;
 
   struct atom *name = car(args);
-  if (name->type != ATOM_TYPE_SYMBOL) {
+  if (atom_type_of(name) != ATOM_TYPE_SYMBOL) {
     return new_atom_error(name, "Error: 'define' first argument must be a symbol");
   }
 
@@ -162,7 +194,7 @@ struct atom *special_form_define(struct atom *args, struct environment *env) {
     return value_evaled;
   }
 
-  if (value_evaled->type == ATOM_TYPE_LAMBDA) {
+  if (atom_type_of(value_evaled) == ATOM_TYPE_LAMBDA) {
     // We need to also overwrite the symbol in the lambda's own environment
     /*
     bound = env_set(value_evaled->value.lambda.env, name, value_evaled);
@@ -181,7 +213,7 @@ struct atom *special_form_set(struct atom *args, struct environment *env) {
   (void)env;
 
   struct atom *name = car(args);
-  if (name->type != ATOM_TYPE_SYMBOL) {
+  if (atom_type_of(name) != ATOM_TYPE_SYMBOL) {
     return new_atom_error(name, "Error: 'set!' first argument must be a symbol");
   }
 
@@ -199,59 +231,62 @@ struct atom *special_form_set(struct atom *args, struct environment *env) {
   return env_set(env, name, value);
 }
 
-struct atom *special_form_begin(struct atom *args, struct environment *env) {
-  (void)env;
-
-  if (!args || args->type != ATOM_TYPE_CONS) {
+// Evaluates all but the last expression in args, which is left in *tail.
+static struct atom *begin_tail(struct atom *args, struct environment **env, struct atom **tail) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS) {
     return new_atom_error(args, "Error: 'begin' requires at least one expression");
   }
 
-  struct atom *result = atom_nil();
-  while (args && args->type == ATOM_TYPE_CONS) {
-    struct atom *expr = car(args);
-
-    result = eval(expr, env);
+  while (is_cons(cdr(args))) {
+    struct atom *result = eval(car(args), *env);
     if (is_error(result)) {
       return result;
     }
     args = cdr(args);
   }
 
-  return result;
+  *tail = car(args);
+  return NULL;
 }
 
-struct atom *special_form_let(struct atom *args, struct environment *env) {
-  (void)env;
-
-  if (!args || args->type != ATOM_TYPE_CONS || !args->value.cons.car || !args->value.cons.cdr ||
-      args->value.cons.cdr->type != ATOM_TYPE_CONS) {
+// The let itself, for args that have already been resolved.
+static struct atom *let_resolved_tail(struct atom *args, struct environment **env,
+                                      struct atom **tail) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS || !atom_cons(args)->car ||
+      !atom_cons(args)->cdr || atom_type_of(atom_cons(args)->cdr) != ATOM_TYPE_CONS) {
     return new_atom_error(args, "Error: 'let' requires a list of bindings and a body");
   }
 
   struct atom *bindings = car(args);
-  if (bindings->type != ATOM_TYPE_CONS) {
+  if (atom_type_of(bindings) != ATOM_TYPE_CONS) {
     return new_atom_error(bindings, "Error: 'let' first argument must be a list of bindings");
   }
 
   struct atom *body = cdr(args);
-  if (body->type != ATOM_TYPE_CONS) {
+  if (atom_type_of(body) != ATOM_TYPE_CONS) {
     return new_atom_error(body, "Error: 'let' body must be a list");
   }
 
-  struct environment *let_env = create_environment(env);
+  size_t count = 0;
+  for (struct atom *cell = bindings; is_cons(cell); cell = cdr(cell)) {
+    ++count;
+  }
 
-  while (bindings && bindings->type == ATOM_TYPE_CONS) {
+  struct environment *let_env = create_frame(*env, count);
+
+  for (size_t slot = 0; bindings && atom_type_of(bindings) == ATOM_TYPE_CONS; ++slot) {
     struct atom *binding = car(bindings);
-    if (binding->type != ATOM_TYPE_CONS || !binding->value.cons.car || !binding->value.cons.cdr) {
+    if (atom_type_of(binding) != ATOM_TYPE_CONS || !atom_cons(binding)->car ||
+        !atom_cons(binding)->cdr) {
       return new_atom_error(binding, "Error: 'let' binding must be a (name value) pair");
     }
 
     struct atom *name = car(binding);
     struct atom *value = car(cdr(binding));
 
-    if (name->type != ATOM_TYPE_SYMBOL) {
+    if (atom_type_of(name) != ATOM_TYPE_SYMBOL) {
       return new_atom_error(name, "Error: 'let' binding name must be a symbol, got %s",
-                            atom_type_to_string(name->type));
+                            atom_type_to_string(atom_type_of(name)));
     }
 
     struct atom *evaled_value = eval(value, let_env);
@@ -259,7 +294,7 @@ struct atom *special_form_let(struct atom *args, struct environment *env) {
       return evaled_value;
     }
 
-    struct atom *bound = env_bind(let_env, name, evaled_value);
+    struct atom *bound = env_bind_slot(let_env, slot, name, evaled_value);
     if (is_error(bound)) {
       return bound;
     }
@@ -267,36 +302,44 @@ struct atom *special_form_let(struct atom *args, struct environment *env) {
     bindings = cdr(bindings);
   }
 
-  struct atom *result = special_form_begin(body, let_env);
+  *env = let_env;
+  return begin_tail(body, env, tail);
+}
+
+static struct atom *let_tail(struct atom *args, struct environment **env, struct atom **tail) {
+  struct atom *resolved = resolve_let(args, *env);
+
+  // the let keeps using its resolved args while it evaluates them (and returns one as the tail)
+  GC_PUSH_FRAME(frame, GC_ROOT(resolved));
+  struct atom *result = let_resolved_tail(resolved, env, tail);
+  GC_POP_FRAME(frame);
 
   return result;
 }
 
-struct atom *special_form_cond(struct atom *args, struct environment *env) {
-  (void)env;
-
-  if (!args || args->type != ATOM_TYPE_CONS) {
+static struct atom *cond_tail(struct atom *args, struct environment **env, struct atom **tail) {
+  if (!args || atom_type_of(args) != ATOM_TYPE_CONS) {
     return new_atom_error(args, "Error: 'cond' requires at least one clause");
   }
 
-  while (args && args->type == ATOM_TYPE_CONS) {
+  while (args && atom_type_of(args) == ATOM_TYPE_CONS) {
     struct atom *clause = car(args);
-    if (clause->type != ATOM_TYPE_CONS || !clause->value.cons.car) {
+    if (atom_type_of(clause) != ATOM_TYPE_CONS || !atom_cons(clause)->car) {
       return new_atom_error(clause, "Error: 'cond' clause must be a (test body) pair, got %s",
-                            atom_type_to_string(clause->type));
+                            atom_type_to_string(atom_type_of(clause)));
     }
 
     struct atom *test = car(clause);
     struct atom *body = cdr(clause);
 
-    struct atom *evaled_test = eval(test, env);
+    struct atom *evaled_test = eval(test, *env);
     if (is_error(evaled_test)) {
       return evaled_test;
     }
 
     // short-circuit evaluation - don't evaluate tests after the first true
     if (is_true(evaled_test)) {
-      return special_form_begin(body, env);
+      return begin_tail(body, env, tail);
     }
 
     args = cdr(args);
@@ -305,6 +348,109 @@ struct atom *special_form_cond(struct atom *args, struct environment *env) {
   return atom_nil();
 }
 
+// Runs a tail special form to completion, for callers other than eval (e.g. apply).
+static struct atom *eval_tail_special(TailSpecialFunction func, struct atom *args,
+                                      struct environment *env) {
+  struct atom *tail = NULL;
+  struct atom *result = func(args, &env, &tail);
+  return result ? result : eval(tail, env);
+}
+
+struct atom *special_form_begin(struct atom *args, struct environment *env) {
+  return eval_tail_special(begin_tail, args, env);
+}
+
+struct atom *special_form_let(struct atom *args, struct environment *env) {
+  return eval_tail_special(let_tail, args, env);
+}
+
+static struct atom *let_resolved(struct atom *args, struct environment *env) {
+  return eval_tail_special(let_resolved_tail, args, env);
+}
+
+struct atom *special_form_cond(struct atom *args, struct environment *env) {
+  return eval_tail_special(cond_tail, args, env);
+}
+
+TailSpecialFunction special_form_tail(struct atom *fn) {
+  if (fn->value.primitive == special_form_begin) {
+    return begin_tail;
+  } else if (fn->value.primitive == special_form_let) {
+    return let_tail;
+  } else if (fn->value.primitive == let_resolved) {
+    return let_resolved_tail;
+  } else if (fn->value.primitive == special_form_cond) {
+    return cond_tail;
+  }
+
+  return NULL;
+}
+
+enum SpecialSyntax special_form_syntax(struct atom *fn) {
+  PrimitiveFunction func = fn->value.primitive;
+  if (func == quote) {
+    return SPECIAL_SYNTAX_QUOTE;
+  } else if (func == quasiquote) {
+    return SPECIAL_SYNTAX_QUASIQUOTE;
+  } else if (func == lambda || func == lambda_resolved) {
+    return SPECIAL_SYNTAX_LAMBDA;
+  } else if (func == defun || func == defun_resolved || func == defmacro ||
+             func == defmacro_resolved) {
+    return SPECIAL_SYNTAX_DEFUN;
+  } else if (func == special_form_let || func == let_resolved) {
+    return SPECIAL_SYNTAX_LET;
+  } else if (func == special_form_define || func == special_form_set) {
+    return SPECIAL_SYNTAX_DEFINE;
+  } else if (func == special_form_cond) {
+    return SPECIAL_SYNTAX_COND;
+  }
+
+  return SPECIAL_SYNTAX_EXPRESSIONS;
+}
+
+// The resolved variants of lambda, defun, defmacro and let, created the first time they're needed
+// and retained until cleanup_special_forms.
+static struct atom *lambda_variant, *defun_variant, *defmacro_variant, *let_variant;
+
+// Returns *variant, first creating it as a long-lived special form for func.
+static struct atom *resolved_variant(struct atom **variant, PrimitiveFunction func) {
+  if (!*variant) {
+    *variant = special_form(func);
+    gc_retain(*variant);
+  }
+
+  return *variant;
+}
+
+struct atom *special_form_resolved(struct atom *fn) {
+  PrimitiveFunction func = fn->value.primitive;
+  if (func == lambda) {
+    return resolved_variant(&lambda_variant, lambda_resolved);
+  } else if (func == defun) {
+    return resolved_variant(&defun_variant, defun_resolved);
+  } else if (func == defmacro) {
+    return resolved_variant(&defmacro_variant, defmacro_resolved);
+  } else if (func == special_form_let) {
+    return resolved_variant(&let_variant, let_resolved);
+  }
+
+  return fn;
+}
+
+static void release_variant(struct atom **variant) {
+  if (*variant) {
+    gc_release(*variant);
+    *variant = NULL;
+  }
+}
+
+void cleanup_special_forms(void) {
+  release_variant(&lambda_variant);
+  release_variant(&defun_variant);
+  release_variant(&defmacro_variant);
+  release_variant(&let_variant);
+}
+
 void init_special_forms(struct environment *env) {
   env_bind(env, intern("quote", 0), special_form(quote));
   env_bind(env, intern("quasiquote", 0), special_form(quasiquote));
@@ -7,7 +7,38 @@
 extern "C" {
 #endif
 
+// Special forms with a tail position (begin, let, cond) evaluate everything before it and then
+// hand the tail expression back in *tail, along with the environment to evaluate it in, so that
+// eval can continue with it iteratively. They return NULL in that case, or the result otherwise.
+typedef struct atom *(*TailSpecialFunction)(struct atom *args, struct environment **env,
+                                             struct atom **tail);
+
 void init_special_forms(struct environment *env);
+// Releases the special forms created for resolved code (see special_form_resolved), which must be
+// done before the final collection.
+void cleanup_special_forms(void);
+
+// Returns the tail-evaluating variant of the given special form, or NULL if it has none.
+TailSpecialFunction special_form_tail(struct atom *fn);
+
+// How the arguments of a special form are laid out, for the resolver (see resolve.h).
+enum SpecialSyntax {
+  SPECIAL_SYNTAX_QUOTE,        // (quote datum), nothing is evaluated
+  SPECIAL_SYNTAX_QUASIQUOTE,   // (quasiquote template), only unquotes are evaluated
+  SPECIAL_SYNTAX_LAMBDA,       // (lambda params body)
+  SPECIAL_SYNTAX_DEFUN,        // (defun name params body), also defmacro
+  SPECIAL_SYNTAX_LET,          // (let ((name value)...) body...)
+  SPECIAL_SYNTAX_DEFINE,       // (define name value), also set!
+  SPECIAL_SYNTAX_COND,         // (cond (test body...)...)
+  SPECIAL_SYNTAX_EXPRESSIONS,  // every argument is an expression, e.g. begin
+};
+
+enum SpecialSyntax special_form_syntax(struct atom *fn);
+
+// Returns the variant of a lambda, defun, defmacro or let special form that expects its body to
+// have been resolved already, so that forms nested in a resolved body aren't resolved again each
+// time they're evaluated. Returns fn itself for any other special form.
+struct atom *special_form_resolved(struct atom *fn);
 
 #ifdef __cplusplus
 }  // extern "C"
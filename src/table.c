@@ -0,0 +1,231 @@
+#include "table.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+// Tables use open addressing with linear probing over a power-of-two array of entries. Removed
+// entries leave a tombstone key behind so that probes for keys placed after them keep going.
+// Tombstones count towards the load factor and are dropped when the table is resized.
+#define TABLE_MIN_CAPACITY 8
+
+static struct atom g_table_tombstone;
+#define TABLE_TOMBSTONE (&g_table_tombstone)
+
+static int table_slot_live(struct table_entry *entry) {
+  return entry->key && entry->key != TABLE_TOMBSTONE;
+}
+
+// Finalizes a 64-bit value so that nearby integers and pointers spread across the table.
+static uint64_t table_mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// Symbols and keywords are interned and never moved by compaction, so their address is a stable
+// hash. Integers and strings hash by value, as equal values may be different atoms.
+static uint64_t table_hash(struct atom *key) {
+  switch (atom_type_of(key)) {
+    case ATOM_TYPE_INT:
+      return table_mix((uint64_t)atom_int(key));
+    case ATOM_TYPE_STRING: {
+      // FNV-1a
+      uint64_t hash = 0xcbf29ce484222325ULL;
+      for (size_t i = 0; i < key->value.string.len; ++i) {
+        hash ^= (unsigned char)key->value.string.ptr[i];
+        hash *= 0x100000001b3ULL;
+      }
+      return table_mix(hash);
+    }
+    default:
+      return table_mix((uint64_t)(uintptr_t)key);
+  }
+}
+
+static int table_keys_equal(struct atom *a, struct atom *b) {
+  if (a == b) {
+    return 1;
+  }
+
+  enum AtomType type = atom_type_of(a);
+  if (type != atom_type_of(b)) {
+    return 0;
+  }
+
+  switch (type) {
+    case ATOM_TYPE_INT:
+      return atom_int(a) == atom_int(b);
+    case ATOM_TYPE_STRING:
+      return a->value.string.len == b->value.string.len &&
+             !memcmp(a->value.string.ptr, b->value.string.ptr, a->value.string.len);
+    default:
+      return 0;
+  }
+}
+
+// Returns the slot holding key, or if there is none, the slot it should be inserted into (the
+// first tombstone or empty slot on its probe sequence). *found is set accordingly. The table must
+// have at least one empty slot.
+static size_t table_find(struct atom *table, struct atom *key, int *found) {
+  struct table_entry *entries = table->value.table.entries;
+  size_t mask = table->value.table.cap - 1;
+  size_t index = table_hash(key) & mask;
+  size_t insert = SIZE_MAX;
+
+  while (entries[index].key) {
+    if (entries[index].key == TABLE_TOMBSTONE) {
+      if (insert == SIZE_MAX) {
+        insert = index;
+      }
+    } else if (table_keys_equal(entries[index].key, key)) {
+      *found = 1;
+      return index;
+    }
+
+    index = (index + 1) & mask;
+  }
+
+  *found = 0;
+  return insert == SIZE_MAX ? index : insert;
+}
+
+// Moves the live entries into a new array with room for at least count entries at the maximum
+// load factor of 3/4.
+static void table_resize(struct atom *table, size_t count) {
+  size_t cap = TABLE_MIN_CAPACITY;
+  while (count * 4 >= cap * 3) {
+    cap *= 2;
+  }
+
+  struct table_entry *old = table->value.table.entries;
+  size_t old_cap = table->value.table.cap;
+
+  table->value.table.entries = calloc(cap, sizeof(struct table_entry));
+  table->value.table.cap = cap;
+  gc_note_external(cap * sizeof(struct table_entry));
+  table->value.table.used = table->value.table.count;
+
+  for (size_t i = 0; i < old_cap; ++i) {
+    if (table_slot_live(&old[i])) {
+      int found = 0;
+      size_t index = table_find(table, old[i].key, &found);
+      table->value.table.entries[index] = old[i];
+    }
+  }
+
+  free(old);
+  gc_forget_external(old_cap * sizeof(struct table_entry));
+}
+
+struct atom *new_table(void) {
+  struct atom *atom = gc_new(GC_TYPE_ATOM, sizeof(struct atom));
+  atom->type = ATOM_TYPE_TABLE;
+  atom->value.table.entries = NULL;
+  atom->value.table.count = 0;
+  atom->value.table.used = 0;
+  atom->value.table.cap = 0;
+  return atom;
+}
+
+int table_key_valid(struct atom *key) {
+  if (!key) {
+    return 0;
+  }
+
+  enum AtomType type = atom_type_of(key);
+  return type == ATOM_TYPE_SYMBOL || type == ATOM_TYPE_KEYWORD || type == ATOM_TYPE_INT ||
+         type == ATOM_TYPE_STRING;
+}
+
+struct atom *table_get(struct atom *table, struct atom *key) {
+  if (!table->value.table.count) {
+    return NULL;
+  }
+
+  int found = 0;
+  size_t index = table_find(table, key, &found);
+  return found ? table->value.table.entries[index].value : NULL;
+}
+
+void table_put(struct atom *table, struct atom *key, struct atom *value) {
+  if ((table->value.table.used + 1) * 4 > table->value.table.cap * 3) {
+    table_resize(table, table->value.table.count + 1);
+  }
+
+  int found = 0;
+  size_t index = table_find(table, key, &found);
+  struct table_entry *entry = &table->value.table.entries[index];
+  if (!found) {
+    if (!entry->key) {
+      ++table->value.table.used;
+    }
+    ++table->value.table.count;
+    entry->key = key;
+  }
+
+  entry->value = value;
+  gc_write_barrier(table);
+}
+
+int table_remove(struct atom *table, struct atom *key) {
+  if (!table->value.table.count) {
+    return 0;
+  }
+
+  int found = 0;
+  size_t index = table_find(table, key, &found);
+  if (!found) {
+    return 0;
+  }
+
+  table->value.table.entries[index].key = TABLE_TOMBSTONE;
+  table->value.table.entries[index].value = NULL;
+  --table->value.table.count;
+  return 1;
+}
+
+struct atom *table_entries(struct atom *table) {
+  struct atom *result = atom_nil();
+  for (size_t i = 0; i < table->value.table.cap; ++i) {
+    struct table_entry *entry = &table->value.table.entries[i];
+    if (table_slot_live(entry)) {
+      result = new_cons(new_cons(entry->key, entry->value), result);
+    }
+  }
+
+  return result;
+}
+
+void table_gc_erase(struct atom *table) {
+  free(table->value.table.entries);
+  table->value.table.entries = NULL;
+  gc_forget_external(table->value.table.cap * sizeof(struct table_entry));
+}
+
+void table_gc_mark_children(struct atom *table) {
+  for (size_t i = 0; i < table->value.table.cap; ++i) {
+    struct table_entry *entry = &table->value.table.entries[i];
+    if (table_slot_live(entry)) {
+      atom_mark(entry->key);
+      atom_mark(entry->value);
+    }
+  }
+}
+
+void table_gc_update_children(struct atom *table) {
+  // Keys hash by identity only if they're symbols or keywords, which are never moved, so moving
+  // the other keys leaves every entry in its slot.
+  for (size_t i = 0; i < table->value.table.cap; ++i) {
+    struct table_entry *entry = &table->value.table.entries[i];
+    if (table_slot_live(entry)) {
+      entry->key = gc_forward(entry->key);
+      entry->value = gc_forward(entry->value);
+    }
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef _QUANTA_TABLE_H
+#define _QUANTA_TABLE_H
+
+#include <stddef.h>
+
+#include "atom.h"
+
+// A slot in a table's open-addressing array. Empty slots have a NULL key.
+struct table_entry {
+  struct atom *key;
+  struct atom *value;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returns a new, empty hash table atom.
+struct atom *new_table(void);
+
+// Returns 1 if the atom can be used as a table key: a symbol, keyword, integer or string. Symbols
+// and keywords are compared by identity, integers and strings by value.
+int table_key_valid(struct atom *key);
+
+// Returns the value stored under key, or NULL if there is none. The key must be valid.
+struct atom *table_get(struct atom *table, struct atom *key);
+// Stores value under key, replacing any previous value. The key must be valid.
+void table_put(struct atom *table, struct atom *key, struct atom *value);
+// Removes the value stored under key. Returns 1 if there was one, 0 otherwise.
+int table_remove(struct atom *table, struct atom *key);
+
+// Returns the table's entries as a list of (key . value) pairs, in no particular order.
+struct atom *table_entries(struct atom *table);
+
+// Frees the table's entry array.
+void table_gc_erase(struct atom *table);
+void table_gc_mark_children(struct atom *table);
+void table_gc_update_children(struct atom *table);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // _QUANTA_TABLE_H
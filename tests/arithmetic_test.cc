@@ -15,7 +15,20 @@ TEST(ArithmeticTest, Add) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 3);
+  EXPECT_EQ(atom_int(atom), 3);
+
+  source_file_free(source);
+}
+
+TEST(ArithmeticTest, FloatArithmetic) {
+  struct source_file *source = source_file_str("(* (+ 1.5 2.25) (- 2.0 4.0))", 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  struct atom *atom = eval(read_atom(source), env);
+  EXPECT_TRUE(is_float(atom));
+  EXPECT_EQ(atom_float(atom), -7.5);
 
   source_file_free(source);
 }
@@ -64,7 +77,7 @@ TEST(ArithmeticTest, Subtract) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 3);
+  EXPECT_EQ(atom_int(atom), 3);
 
   source_file_free(source);
 }
@@ -77,7 +90,7 @@ TEST(ArithmeticTest, Multiply) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 12);
+  EXPECT_EQ(atom_int(atom), 12);
 
   source_file_free(source);
 }
@@ -90,7 +103,24 @@ TEST(ArithmeticTest, Divide) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 4);
+  EXPECT_EQ(atom_int(atom), 4);
+
+  source_file_free(source);
+}
+
+TEST(ArithmeticTest, DivideByZero) {
+  struct source_file *source =
+      source_file_str("(/ 5 0)\n(/ 100000000000000000000000 0)\n(/ 5 1 0)", 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  // an error however large the dividend
+  for (int i = 0; i < 3; ++i) {
+    struct atom *atom = eval(read_atom(source), env);
+    ASSERT_TRUE(is_error(atom));
+    EXPECT_STREQ(atom->value.error.message, "division by zero");
+  }
 
   source_file_free(source);
 }
@@ -0,0 +1,129 @@
+#include <array.h>
+#include <atom.h>
+#include <env.h>
+#include <eval.h>
+#include <gc.h>
+#include <gtest/gtest.h>
+#include <log.h>
+#include <math.h>
+#include <read.h>
+#include <source.h>
+
+// Lengths around the vector width, so both the vector loops and the scalar tails are covered.
+static const size_t kLengths[] = {1, 3, 4, 5, 8, 13, 100};
+
+TEST(ArrayTest, IntKernelsMatchScalar) {
+  for (size_t len : kLengths) {
+    struct atom *a = new_array(ATOM_TYPE_INT, len);
+    struct atom *b = new_array(ATOM_TYPE_INT, len);
+    int64_t sum = 0, dot = 0, min = INT64_MAX, max = INT64_MIN;
+    for (size_t i = 0; i < len; ++i) {
+      int64_t x = (int64_t)((i * 7919) % 101) - 50;
+      int64_t y = (int64_t)i - 3;
+      array_set(a, i, new_int(x));
+      array_set(b, i, new_int(y));
+      sum += x;
+      dot += x * y;
+      min = x < min ? x : min;
+      max = x > max ? x : max;
+    }
+
+    EXPECT_EQ(atom_int(array_sum(a)), sum) << len;
+    EXPECT_EQ(atom_int(array_dot(a, b)), dot) << len;
+    EXPECT_EQ(atom_int(array_min(a)), min) << len;
+    EXPECT_EQ(atom_int(array_max(a)), max) << len;
+
+    struct atom *added = array_add(a, b);
+    struct atom *multiplied = array_mul(a, b);
+    for (size_t i = 0; i < len; ++i) {
+      EXPECT_EQ(added->value.array.data.ints[i],
+                a->value.array.data.ints[i] + b->value.array.data.ints[i]);
+      EXPECT_EQ(multiplied->value.array.data.ints[i],
+                a->value.array.data.ints[i] * b->value.array.data.ints[i]);
+    }
+  }
+}
+
+TEST(ArrayTest, FloatKernelsMatchScalar) {
+  for (size_t len : kLengths) {
+    struct atom *a = new_array(ATOM_TYPE_FLOAT, len);
+    struct atom *b = new_array(ATOM_TYPE_FLOAT, len);
+    double sum = 0, dot = 0, min = INFINITY, max = -INFINITY;
+    for (size_t i = 0; i < len; ++i) {
+      // Small multiples of 0.5 add up exactly in any order.
+      double x = (double)((i * 7919) % 101) * 0.5 - 25.0;
+      double y = (double)i * 0.5;
+      array_set(a, i, new_float(x));
+      array_set(b, i, new_float(y));
+      sum += x;
+      dot += x * y;
+      min = x < min ? x : min;
+      max = x > max ? x : max;
+    }
+
+    EXPECT_EQ(atom_float(array_sum(a)), sum) << len;
+    EXPECT_EQ(atom_float(array_dot(a, b)), dot) << len;
+    EXPECT_EQ(atom_float(array_min(a)), min) << len;
+    EXPECT_EQ(atom_float(array_max(a)), max) << len;
+
+    struct atom *added = array_add(a, b);
+    for (size_t i = 0; i < len; ++i) {
+      EXPECT_EQ(added->value.array.data.floats[i],
+                a->value.array.data.floats[i] + b->value.array.data.floats[i]);
+    }
+  }
+}
+
+TEST(ArrayTest, ElementsCountTowardsBudget) {
+  gc_run();
+
+  new_array(ATOM_TYPE_FLOAT, 100000);
+
+  EXPECT_GT(gc_maybe_run(), 0u);
+}
+
+TEST(ArrayTest, Errors) {
+  struct atom *ints = new_array(ATOM_TYPE_INT, 4);
+  EXPECT_TRUE(is_error(array_add(ints, new_array(ATOM_TYPE_FLOAT, 4))));
+  EXPECT_TRUE(is_error(array_dot(ints, new_array(ATOM_TYPE_INT, 5))));
+  EXPECT_TRUE(is_error(array_set(ints, 0, new_float(1.0))));
+  EXPECT_TRUE(is_error(array_min(new_array(ATOM_TYPE_INT, 0))));
+  EXPECT_EQ(atom_int(array_sum(new_array(ATOM_TYPE_INT, 0))), 0);
+}
+
+TEST(ArrayTest, MakeArrayTooLarge) {
+  // len * sizeof(int64_t) doesn't fit in a size_t for this length.
+  struct source_file *source = source_file_str("(make-array :int 4611686018427387903)", 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  EXPECT_TRUE(is_error(eval(read_atom(source), env)));
+
+  source_file_free(source);
+}
+
+TEST(ArrayTest, Primitives) {
+  struct source_file *source = source_file_str(
+      "(define a (array :float 1.5 2.5 3.5 4.5 5.5))"
+      "(array-sum (array-mul a a))"
+      "(array-ref (array-map - a) 2)"
+      "(array-length (make-array :int 10))"
+      "(array-set! a 0 1)"
+      "(array-ref a 5)"
+      "(array-map (lambda (x) x) a)",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  eval(read_atom(source), env);
+  EXPECT_EQ(atom_float(eval(read_atom(source), env)), 71.25);
+  EXPECT_EQ(atom_float(eval(read_atom(source), env)), 3.5);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 10);
+  EXPECT_TRUE(is_error(eval(read_atom(source), env)));
+  EXPECT_TRUE(is_error(eval(read_atom(source), env)));
+  EXPECT_TRUE(is_error(eval(read_atom(source), env)));
+
+  source_file_free(source);
+}
@@ -3,10 +3,14 @@
 #include <eval.h>
 #include <gc.h>
 #include <gtest/gtest.h>
+#include <intern.h>
 #include <log.h>
+#include <math.h>
 #include <read.h>
 #include <source.h>
 
+#include <string>
+
 TEST(AtomsTest, QuoteList) {
   struct source_file *source = source_file_str("(quote (1 2 3))", 0);
   ASSERT_TRUE(source != NULL);
@@ -19,18 +23,18 @@ TEST(AtomsTest, QuoteList) {
 
   struct atom *entry = car(quoted_list);
   EXPECT_TRUE(is_int(entry));
-  EXPECT_EQ(entry->value.ivalue, 1);
+  EXPECT_EQ(atom_int(entry), 1);
 
   quoted_list = cdr(quoted_list);
 
   entry = car(quoted_list);
   EXPECT_TRUE(is_int(entry));
-  EXPECT_EQ(entry->value.ivalue, 2);
+  EXPECT_EQ(atom_int(entry), 2);
   quoted_list = cdr(quoted_list);
 
   entry = car(quoted_list);
   EXPECT_TRUE(is_int(entry));
-  EXPECT_EQ(entry->value.ivalue, 3);
+  EXPECT_EQ(atom_int(entry), 3);
 
   quoted_list = cdr(quoted_list);
   EXPECT_TRUE(is_nil(quoted_list));
@@ -108,3 +112,108 @@ TEST(AtomTest, EscapedStringAtom) {
 
   source_file_free(source);
 }
+
+TEST(AtomsTest, ShortStringsAreInline) {
+  struct atom *atom = new_string(ATOM_TYPE_STRING, "short", 5);
+  EXPECT_EQ(atom->value.string.ptr, atom->value.string.storage.small);
+  EXPECT_STREQ(atom->value.string.ptr, "short");
+
+  const char *text = "a string much too long to be stored inline";
+  atom = new_string(ATOM_TYPE_STRING, text, strlen(text));
+  EXPECT_NE(atom->value.string.ptr, atom->value.string.storage.small);
+  EXPECT_STREQ(atom->value.string.ptr, text);
+  EXPECT_EQ(atom->value.string.len, strlen(text));
+
+  EXPECT_EQ(intern("sym", 0)->value.string.ptr, intern("sym", 0)->value.string.storage.small);
+}
+
+TEST(AtomsTest, SubstringsShareBuffers) {
+  const char *text = "the quick brown fox jumps over the lazy dog";
+  struct atom *string = new_string(ATOM_TYPE_STRING, text, strlen(text));
+  struct atom *substring = new_substring(string, 4, 25);
+  EXPECT_EQ(substring->value.string.ptr, string->value.string.ptr + 4);
+  EXPECT_EQ(substring->value.string.storage.buffer, string->value.string.storage.buffer);
+
+  // The buffer outlives the string it was made for.
+  GC_PUSH_FRAME(frame, GC_ROOT(substring));
+  string = NULL;
+  gc_run();
+  GC_POP_FRAME(frame);
+  EXPECT_EQ(std::string(substring->value.string.ptr, substring->value.string.len),
+            "quick brown fox jumps ove");
+
+  // Short substrings are copied inline instead.
+  struct atom *fox = new_substring(substring, 12, 3);
+  EXPECT_STREQ(fox->value.string.ptr, "fox");
+  EXPECT_EQ(fox->value.string.ptr, fox->value.string.storage.small);
+}
+
+TEST(AtomsTest, StringsCompareByLength) {
+  struct source_file *source = source_file_str("(eq? \"ab\" \"abc\")", 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+  EXPECT_TRUE(is_nil(eval(read_atom(source), env)));
+
+  // Embedded NULs are part of the string.
+  struct atom *args = new_cons(new_string(ATOM_TYPE_STRING, "a\0b", 3),
+                               new_cons(new_string(ATOM_TYPE_STRING, "a\0c", 3), atom_nil()));
+  EXPECT_TRUE(is_nil(apply(env_lookup(env, intern("eq?", 0)), args, env)));
+
+  source_file_free(source);
+}
+
+TEST(AtomsTest, SmallIntegersAreFixnums) {
+  struct atom *atom = new_int(-42);
+  EXPECT_TRUE(is_fixnum(atom));
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_type_of(atom), ATOM_TYPE_INT);
+  EXPECT_EQ(atom_int(atom), -42);
+  EXPECT_EQ(new_int(-42), atom);
+
+  EXPECT_EQ(atom_int(new_int(ATOM_FIXNUM_MAX)), ATOM_FIXNUM_MAX);
+  EXPECT_EQ(atom_int(new_int(ATOM_FIXNUM_MIN)), ATOM_FIXNUM_MIN);
+
+  // Too large for a fixnum, so it's allocated instead.
+  atom = new_int(INT64_MAX);
+  EXPECT_FALSE(is_fixnum(atom));
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_int(atom), INT64_MAX);
+
+  EXPECT_FALSE(is_cons(new_int(1)));
+  EXPECT_FALSE(is_error(new_int(1)));
+  EXPECT_TRUE(is_error(car(new_int(1))));
+}
+
+TEST(AtomsTest, IntegerLiteralsAndArithmeticAreFixnums) {
+  struct source_file *source = source_file_str("(+ 1 (* 2 3) (- 10 4) (/ 8 2))", 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  struct atom *expr = read_atom(source);
+  EXPECT_TRUE(is_fixnum(car(cdr(expr))));
+
+  struct atom *atom = eval(expr, env);
+  EXPECT_TRUE(is_fixnum(atom));
+  EXPECT_EQ(atom_int(atom), 17);
+
+  source_file_free(source);
+}
+
+TEST(AtomsTest, FloatsRoundTrip) {
+  const double values[] = {0.0, -0.0, 1.5, -3.25, 1e300, -1e-300, INFINITY, -INFINITY};
+  for (double value : values) {
+    struct atom *atom = new_float(value);
+    EXPECT_TRUE(is_float(atom));
+    EXPECT_FALSE(is_int(atom));
+    EXPECT_EQ(atom_type_of(atom), ATOM_TYPE_FLOAT);
+    EXPECT_EQ(atom_float(atom), value);
+#ifdef QUANTA_NAN_BOXING
+    EXPECT_TRUE(is_immediate(atom));
+#endif
+  }
+
+  EXPECT_TRUE(isnan(atom_float(new_float(NAN))));
+  EXPECT_TRUE(is_float(new_float(-NAN)));
+}
@@ -0,0 +1,174 @@
+#include <atom.h>
+#include <bignum.h>
+#include <env.h>
+#include <eval.h>
+#include <gc.h>
+#include <gtest/gtest.h>
+#include <log.h>
+#include <print.h>
+#include <read.h>
+#include <source.h>
+
+#include <string>
+
+static std::string to_string(struct atom *atom) {
+  char buffer[4096];
+  print_str(buffer, sizeof(buffer), atom, 1);
+  return buffer;
+}
+
+// Multiplies by a small factor at a time, which only takes the schoolbook path.
+static struct atom *power(int64_t base, int exponent) {
+  struct atom *result = new_int(1);
+  for (int i = 0; i < exponent; ++i) {
+    result = bignum_mul(result, new_int(base));
+  }
+  return result;
+}
+
+TEST(BignumTest, PromotesOnOverflowAndBack) {
+  struct source_file *source = source_file_str(
+      "(+ 9223372036854775807 1)"
+      "(- (+ 9223372036854775807 1) 1)"
+      "(* 4294967296 4294967296)"
+      "(- -9223372036854775807 2)"
+      "(/ -9223372036854775808 -1)"
+      "(* 3000000000 -3000000000)",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  struct atom *atom = eval(read_atom(source), env);
+  EXPECT_TRUE(is_bignum(atom));
+  EXPECT_EQ(to_string(atom), "9223372036854775808");
+
+  atom = eval(read_atom(source), env);
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_int(atom), INT64_MAX);
+
+  EXPECT_EQ(to_string(eval(read_atom(source), env)), "18446744073709551616");
+  EXPECT_EQ(to_string(eval(read_atom(source), env)), "-9223372036854775809");
+  EXPECT_EQ(to_string(eval(read_atom(source), env)), "9223372036854775808");
+
+  atom = eval(read_atom(source), env);
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_int(atom), -9000000000000000000);
+
+  source_file_free(source);
+}
+
+TEST(BignumTest, Factorial) {
+  struct source_file *source = source_file_str(
+      "(defun factorial (n) (cond ((eq? n 0) 1) (t (* n (factorial (- n 1))))))"
+      "(factorial 20)"
+      "(factorial 30)"
+      "(/ (factorial 30) (factorial 28))",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  eval(read_atom(source), env);
+  struct atom *atom = eval(read_atom(source), env);
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_int(atom), 2432902008176640000);
+  EXPECT_EQ(to_string(eval(read_atom(source), env)), "265252859812191058636308480000000");
+
+  atom = eval(read_atom(source), env);
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_int(atom), 870);
+
+  source_file_free(source);
+}
+
+TEST(BignumTest, ReadsAndPrintsLiterals) {
+  struct source_file *source = source_file_str(
+      "123456789012345678901234567890 -123456789012345678901234567890 "
+      "-9223372036854775808 -9223372036854775809 000000000000000000000042 "
+      "(eq? 123456789012345678901234567890 123456789012345678901234567890)",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  EXPECT_EQ(to_string(read_atom(source)), "123456789012345678901234567890");
+  EXPECT_EQ(to_string(read_atom(source)), "-123456789012345678901234567890");
+
+  struct atom *atom = read_atom(source);
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_int(atom), INT64_MIN);
+
+  atom = read_atom(source);
+  EXPECT_TRUE(is_bignum(atom));
+  EXPECT_EQ(to_string(atom), "-9223372036854775809");
+
+  atom = read_atom(source);
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_int(atom), 42);
+
+  EXPECT_TRUE(is_true(eval(read_atom(source), env)));
+
+  source_file_free(source);
+}
+
+TEST(BignumTest, KaratsubaMatchesSchoolbook) {
+  // About 150, 220 and 50 digits of 32 bits: a balanced and an unbalanced Karatsuba product.
+  struct atom *a = power(3, 3000);
+  struct atom *b = power(7, 2500);
+  struct atom *c = power(5, 700);
+
+  struct atom *ab = a;
+  for (int i = 0; i < 2500; ++i) {
+    ab = bignum_mul(ab, new_int(7));
+  }
+  EXPECT_EQ(bignum_compare(bignum_mul(a, b), ab), 0);
+
+  struct atom *ac = a;
+  for (int i = 0; i < 700; ++i) {
+    ac = bignum_mul(ac, new_int(5));
+  }
+  EXPECT_EQ(bignum_compare(bignum_mul(a, c), ac), 0);
+  EXPECT_EQ(bignum_compare(bignum_mul(c, bignum_sub(new_int(0), a)), bignum_sub(new_int(0), ac)),
+            0);
+
+  // (a + b)^2 = a^2 + 2ab + b^2
+  struct atom *sum = bignum_add(a, b);
+  struct atom *expanded =
+      bignum_add(bignum_add(bignum_mul(a, a), bignum_mul(new_int(2), ab)), bignum_mul(b, b));
+  EXPECT_EQ(bignum_compare(bignum_mul(sum, sum), expanded), 0);
+}
+
+TEST(BignumTest, Division) {
+  struct atom *base = power(2, 32);
+  // B^6 - 1 has all digits set, which makes for extreme quotient digit estimates.
+  struct atom *ones = bignum_sub(power(2, 192), new_int(1));
+  struct atom *dividends[] = {power(3, 3000), ones, bignum_mul(ones, ones), power(2, 500)};
+  struct atom *divisors[] = {new_int(7),
+                             new_int(-1000000007),
+                             base,
+                             bignum_sub(power(2, 96), new_int(1)),
+                             bignum_add(power(2, 127), new_int(1)),
+                             power(10, 40),
+                             bignum_sub(new_int(0), power(11, 300))};
+
+  for (struct atom *dividend : dividends) {
+    for (struct atom *divisor : divisors) {
+      struct atom *quotient = bignum_div(dividend, divisor);
+      struct atom *remainder = bignum_sub(dividend, bignum_mul(quotient, divisor));
+      // truncated division: the remainder takes the dividend's sign and is smaller than the
+      // divisor
+      EXPECT_GE(bignum_compare(remainder, new_int(0)), 0) << to_string(divisor);
+      if (bignum_compare(divisor, new_int(0)) > 0) {
+        EXPECT_LT(bignum_compare(remainder, divisor), 0) << to_string(divisor);
+      } else {
+        EXPECT_LT(bignum_compare(bignum_add(remainder, divisor), new_int(0)), 0)
+            << to_string(divisor);
+      }
+    }
+  }
+
+  EXPECT_TRUE(is_error(bignum_div(ones, new_int(0))));
+  EXPECT_EQ(to_string(bignum_div(bignum_sub(new_int(0), power(10, 30)), power(10, 25))),
+            "-100000");
+}
@@ -21,7 +21,7 @@ TEST(CommentTest, TrailingComment) {
 
   struct atom *atom = read_atom(source);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 5);
+  EXPECT_EQ(atom_int(atom), 5);
 
   source_file_free(source);
 }
@@ -34,8 +34,8 @@ TEST(CommentTest, InterleavedComment) {
   EXPECT_TRUE(is_cons(atom));
   EXPECT_TRUE(is_int(car(atom)));
   EXPECT_TRUE(is_int(cdr(atom)));
-  EXPECT_EQ(car(atom)->value.ivalue, 5);
-  EXPECT_EQ(cdr(atom)->value.ivalue, 6);
+  EXPECT_EQ(atom_int(car(atom)), 5);
+  EXPECT_EQ(atom_int(cdr(atom)), 6);
 
   source_file_free(source);
 }
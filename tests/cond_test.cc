@@ -15,7 +15,7 @@ TEST(ConditionalsTest, Equality) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 2);
+  EXPECT_EQ(atom_int(atom), 2);
 
   source_file_free(source);
 }
@@ -29,7 +29,7 @@ TEST(ConditionalsTest, NestedConditions) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 3);
+  EXPECT_EQ(atom_int(atom), 3);
 
   source_file_free(source);
 }
@@ -19,11 +19,11 @@ TEST(ConsTest, CarCdrCorrectness) {
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 1);
+  EXPECT_EQ(atom_int(atom), 1);
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 2);
+  EXPECT_EQ(atom_int(atom), 2);
 
   source_file_free(source);
 }
@@ -49,15 +49,15 @@ TEST(ConsTest, NestedCons) {
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 1);
+  EXPECT_EQ(atom_int(atom), 1);
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 2);
+  EXPECT_EQ(atom_int(atom), 2);
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 3);
+  EXPECT_EQ(atom_int(atom), 3);
 
   source_file_free(source);
 }
@@ -74,11 +74,11 @@ TEST(ConsTest, DottedPair) {
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 1);
+  EXPECT_EQ(atom_int(atom), 1);
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 2);
+  EXPECT_EQ(atom_int(atom), 2);
 
   source_file_free(source);
 }
@@ -95,11 +95,11 @@ TEST(ConsTest, DottedPairQuasi) {
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 1);
+  EXPECT_EQ(atom_int(atom), 1);
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 2);
+  EXPECT_EQ(atom_int(atom), 2);
 
   source_file_free(source);
 }
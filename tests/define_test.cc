@@ -19,7 +19,7 @@ TEST(DefineTests, DefunSquare) {
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 25);
+  EXPECT_EQ(atom_int(atom), 25);
 
   source_file_free(source);
 }
@@ -45,7 +45,40 @@ TEST(DefineTests, Closures) {
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 15);
+  EXPECT_EQ(atom_int(atom), 15);
+
+  gc_release(env);
+
+  source_file_free(source);
+}
+
+TEST(DefineTests, ClosuresShareTheirEnvironment) {
+  struct source_file *source = source_file_str(
+      "(defun f () (g 1))\n"
+      "(defun g (x) (+ x 1))\n"
+      "(f)\n"
+      "(defun sum-to (n) (begin (define loop (lambda (i) (cond ((eq? i 0) 0)\n"
+      "                                                        (t (+ i (loop (- i 1)))))))\n"
+      "                         (loop n)))\n"
+      "(sum-to 4)",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+  gc_retain(env);
+
+  // a function defined later is seen by one defined before it
+  eval(read_atom(source), env);
+  eval(read_atom(source), env);
+  struct atom *atom = eval(read_atom(source), env);
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_int(atom), 2);
+
+  // and so is a local function's own name, defined after the function was created
+  eval(read_atom(source), env);
+  atom = eval(read_atom(source), env);
+  EXPECT_TRUE(is_int(atom));
+  EXPECT_EQ(atom_int(atom), 10);
 
   gc_release(env);
 
@@ -68,7 +101,7 @@ TEST(DefineTests, MutableBindings) {
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 42);
+  EXPECT_EQ(atom_int(atom), 42);
 
   source_file_free(source);
 }
@@ -90,7 +123,7 @@ TEST(DefineTests, RecursiveFunction) {
 
   atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 120);
+  EXPECT_EQ(atom_int(atom), 120);
 
   source_file_free(source);
 }
@@ -126,8 +159,8 @@ TEST(DefineTests, Macros) {
   EXPECT_TRUE(is_cons(atom));
   EXPECT_TRUE(is_int(car(atom)));
   EXPECT_TRUE(is_int(cdr(atom)));
-  EXPECT_EQ(car(atom)->value.ivalue, 1);
-  EXPECT_EQ(cdr(atom)->value.ivalue, 1);
+  EXPECT_EQ(atom_int(car(atom)), 1);
+  EXPECT_EQ(atom_int(cdr(atom)), 1);
 
   source_file_free(source);
 }
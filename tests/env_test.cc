@@ -0,0 +1,124 @@
+#include <atom.h>
+#include <env.h>
+#include <eval.h>
+#include <gc.h>
+#include <gtest/gtest.h>
+#include <intern.h>
+#include <log.h>
+#include <read.h>
+#include <source.h>
+
+#include <string>
+
+static struct atom *symbol(int i) {
+  return intern(("env-test-" + std::to_string(i)).c_str(), 0);
+}
+
+TEST(EnvTest, ManyBindingsByName) {
+  // enough to outgrow the frame's array and move to a hash table (root environments use globals)
+  struct environment *env = create_environment(create_environment(NULL));
+  for (int i = 0; i < 20; ++i) {
+    EXPECT_FALSE(is_error(env_bind(env, symbol(i), new_int(i))));
+    EXPECT_TRUE(is_error(env_bind(env, symbol(i / 2), new_int(i))));
+  }
+
+  EXPECT_FALSE(is_error(env_set(env, symbol(3), new_int(33))));
+  for (int i = 0; i < 20; ++i) {
+    struct atom *value = env_lookup(env, symbol(i));
+    ASSERT_TRUE(value != NULL);
+    EXPECT_EQ(atom_int(value), i == 3 ? 33 : i);
+  }
+  EXPECT_EQ(env_lookup(env, symbol(20)), nullptr);
+}
+
+TEST(EnvTest, SlotsAndBindingsByName) {
+  struct environment *env = create_frame(NULL, 6);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_FALSE(is_error(env_bind_slot(env, i, symbol(i), new_int(i))));
+  }
+  EXPECT_TRUE(is_error(env_bind(env, symbol(2), new_int(0))));
+  EXPECT_FALSE(is_error(env_bind(env, symbol(6), new_int(6))));
+
+  for (int i = 0; i < 7; ++i) {
+    struct atom *value = env_lookup(env, symbol(i));
+    ASSERT_TRUE(value != NULL);
+    EXPECT_EQ(atom_int(value), i);
+  }
+}
+
+TEST(EnvTest, LargeFrames) {
+  struct source_file *source = source_file_str(
+      "(defun f (a b c d e g) (let ((h (* a b)) (i c) (j d) (k e) (l g)) (+ h i j k l)))"
+      "(f 1 2 3 4 5 6)"
+      "(defun g (x) (begin (define a 1) (define b 2) (define c 3) (define d 4) (define e 5)"
+      "                    (define f2 6) (define g2 7) (define h 8) (define i 9) (define j 10)"
+      "                    (+ x a b c d e f2 g2 h i j)))"
+      "(g 100)",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  eval(read_atom(source), env);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 20);
+  eval(read_atom(source), env);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 155);
+
+  source_file_free(source);
+}
+
+TEST(EnvTest, GlobalsAndShadowing) {
+  struct environment *a = create_environment(NULL);
+  struct environment *b = create_environment(NULL);
+  env_bind(a, symbol(100), new_int(1));
+  env_bind(b, symbol(100), new_int(2));
+
+  // each nested environment finds the global of its own root
+  struct environment *inner_a = create_frame(create_frame(a, 0), 0);
+  struct environment *inner_b = create_frame(b, 1);
+  EXPECT_EQ(atom_int(env_lookup(inner_a, symbol(100))), 1);
+  EXPECT_EQ(atom_int(env_lookup(inner_b, symbol(100))), 2);
+
+  env_set(inner_a, symbol(100), new_int(3));
+  EXPECT_EQ(atom_int(env_lookup(a, symbol(100))), 3);
+  EXPECT_EQ(atom_int(env_lookup(inner_b, symbol(100))), 2);
+
+  // a binding anywhere else shadows the global in the environments under it only
+  env_bind_slot(inner_b, 0, symbol(100), new_int(4));
+  env_bind(create_frame(a, 0), symbol(101), new_int(5));
+  EXPECT_EQ(atom_int(env_lookup(inner_b, symbol(100))), 4);
+  EXPECT_EQ(atom_int(env_lookup(create_frame(b, 0), symbol(100))), 2);
+  EXPECT_EQ(atom_int(env_lookup(inner_a, symbol(100))), 3);
+  EXPECT_EQ(env_lookup(inner_a, symbol(101)), nullptr);
+
+  env_set(inner_b, symbol(100), new_int(6));
+  EXPECT_EQ(atom_int(env_lookup(b, symbol(100))), 2);
+
+  // a global defined after it was first looked up
+  EXPECT_EQ(env_lookup(inner_a, symbol(102)), nullptr);
+  env_bind(a, symbol(102), new_int(7));
+  EXPECT_EQ(atom_int(env_lookup(inner_a, symbol(102))), 7);
+}
+
+TEST(EnvTest, ResetShadows) {
+  struct environment *a = create_environment(NULL);
+  struct environment *inner_a = create_frame(a, 1);
+  env_bind(a, symbol(200), new_int(1));
+  env_bind_slot(inner_a, 0, symbol(200), new_int(2));
+
+  env_reset_shadows();
+
+  // environments created before the reset still find the bindings that shadow a global
+  EXPECT_EQ(atom_int(env_lookup(inner_a, symbol(200))), 2);
+  EXPECT_EQ(atom_int(env_lookup(create_frame(inner_a, 0), symbol(200))), 2);
+  EXPECT_EQ(atom_int(env_lookup(a, symbol(200))), 1);
+
+  // and those created since count them afresh
+  struct environment *b = create_environment(NULL);
+  struct environment *inner_b = create_frame(b, 1);
+  env_bind(b, symbol(200), new_int(3));
+  EXPECT_EQ(atom_int(env_lookup(inner_b, symbol(200))), 3);
+  env_bind_slot(inner_b, 0, symbol(200), new_int(4));
+  EXPECT_EQ(atom_int(env_lookup(inner_b, symbol(200))), 4);
+  EXPECT_EQ(atom_int(env_lookup(create_frame(b, 0), symbol(200))), 3);
+}
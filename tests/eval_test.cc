@@ -15,7 +15,7 @@ TEST(EvalTest, ApplyFunction) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 10);
+  EXPECT_EQ(atom_int(atom), 10);
 
   source_file_free(source);
 }
@@ -28,7 +28,7 @@ TEST(EvalTest, EvalQuoted) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 3);
+  EXPECT_EQ(atom_int(atom), 3);
 
   source_file_free(source);
 }
@@ -50,12 +50,12 @@ TEST(EvalTest, EvalPerformsTCO) {
 
   atom = eval(read_atom(source), env);
   EXPECT_FALSE(is_error(atom));
-  fprintf(stderr, "Result type: %s\n", atom_type_to_string(atom->type));
+  fprintf(stderr, "Result type: %s\n", atom_type_to_string(atom_type_of(atom)));
   if (is_error(atom)) {
     fprintf(stderr, "Error: %s\n", atom->value.error.message);
   }
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 50005000);
+  EXPECT_EQ(atom_int(atom), 50005000);
 
   source_file_free(source);
 
@@ -0,0 +1,613 @@
+#include <atom.h>
+#include <env.h>
+#include <eval.h>
+#include <gc.h>
+#include <gtest/gtest.h>
+#include <intern.h>
+#include <log.h>
+#include <read.h>
+#include <source.h>
+
+#include <string>
+#include <vector>
+
+// Integers normally aren't allocated at all, but these tests need heap objects to collect.
+static struct atom *new_boxed_int(int64_t value) {
+  union atom_value v;
+  v.ivalue = value;
+  return new_atom(ATOM_TYPE_INT, v);
+}
+
+// Allocates enough short-lived atoms to reuse any cells freed by a previous collection.
+static void churn(void) {
+  for (int i = 0; i < 10000; ++i) {
+    new_boxed_int(i);
+  }
+}
+
+TEST(GCTest, MinorCollectionFreesNursery) {
+  gc_run();
+
+  for (int i = 0; i < 1000; ++i) {
+    new_boxed_int(i);
+  }
+
+  size_t freed = gc_run_minor();
+  EXPECT_GE(freed, 1000 * sizeof(struct atom));
+}
+
+TEST(GCTest, ConsCellsAreCompact) {
+  gc_run();
+
+  for (int i = 0; i < 1000; ++i) {
+    new_cons(atom_nil(), atom_nil());
+  }
+
+  // Just the car and cdr, with no type or header.
+  EXPECT_EQ(gc_run(), 1000 * 2 * sizeof(struct atom *));
+}
+
+TEST(GCTest, ListCellsAreContiguous) {
+  gc_run();
+
+  // Leave a slab full of freed cells behind, which new lists should reuse in address order.
+  for (int i = 0; i < 1000; ++i) {
+    new_cons(atom_nil(), atom_nil());
+  }
+  gc_run();
+
+  struct source_file *source = source_file_str("(+ 1 2 3 4 5 6 7)", 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct atom *lists[] = {read_atom(source), new_list(NULL, 8, NULL)};
+  for (struct atom *list : lists) {
+    for (struct atom *cell = list; is_cons(cdr(cell)); cell = cdr(cell)) {
+      EXPECT_EQ((char *)cdr(cell) - (char *)cell, (ptrdiff_t)sizeof(struct cons));
+    }
+  }
+
+  source_file_free(source);
+}
+
+TEST(GCTest, FrameRootsLocals) {
+  gc_run();
+
+  struct atom *list = new_cons(new_boxed_int(1), atom_nil());
+  struct atom *unset = NULL;
+  GC_PUSH_FRAME(frame, GC_ROOT(list), GC_ROOT(unset));
+
+  gc_run();
+  churn();
+
+  // Roots are read when the GC runs, so reassigned locals are tracked too.
+  list = new_cons(new_boxed_int(2), list);
+  gc_run();
+  churn();
+
+  GC_POP_FRAME(frame);
+
+  EXPECT_EQ(atom_int(car(list)), 2);
+  EXPECT_EQ(atom_int(car(cdr(list))), 1);
+  EXPECT_TRUE(is_nil(cdr(cdr(list))));
+
+  // Once popped, the frame no longer keeps anything alive.
+  EXPECT_GE(gc_run(), 2 * (sizeof(struct cons) + sizeof(struct atom)));
+}
+
+TEST(GCTest, RetainIsCounted) {
+  gc_run();
+
+  struct atom *atom = new_boxed_int(42);
+  gc_retain(atom);
+  gc_retain(atom);
+
+  gc_release(atom);
+  EXPECT_EQ(gc_run(), 0);
+
+  gc_release(atom);
+  EXPECT_EQ(gc_run(), sizeof(struct atom));
+}
+
+TEST(GCTest, MinorCollectionKeepsOldObjects) {
+  struct atom *old = new_cons(new_boxed_int(1), new_boxed_int(2));
+  gc_retain(old);
+  gc_run();
+  gc_release(old);
+
+  // No longer rooted, but old objects are only reclaimed by a full collection.
+  gc_run_minor();
+  churn();
+  gc_run_minor();
+
+  EXPECT_TRUE(is_cons(old));
+  EXPECT_EQ(atom_int(car(old)), 1);
+  EXPECT_EQ(atom_int(cdr(old)), 2);
+}
+
+TEST(GCTest, BindInOldEnvironmentSurvivesMinor) {
+  struct environment *env = create_default_environment();
+  gc_retain(env);
+  gc_run();
+
+  // env is old now; the new binding cell and value are young and only reachable through it
+  env_bind(env, intern("gc-test-bound", 0), new_boxed_int(42));
+
+  gc_run_minor();
+  churn();
+
+  struct atom *value = env_lookup(env, intern("gc-test-bound", 0));
+  ASSERT_TRUE(value != NULL);
+  EXPECT_TRUE(is_int(value));
+  EXPECT_EQ(atom_int(value), 42);
+
+  gc_release(env);
+}
+
+TEST(GCTest, SetInOldEnvironmentSurvivesMinor) {
+  struct environment *env = create_default_environment();
+  gc_retain(env);
+  env_bind(env, intern("gc-test-set", 0), new_boxed_int(1));
+  gc_run();
+
+  env_set(env, intern("gc-test-set", 0), new_boxed_int(2));
+
+  gc_run_minor();
+  churn();
+
+  struct atom *value = env_lookup(env, intern("gc-test-set", 0));
+  ASSERT_TRUE(value != NULL);
+  EXPECT_TRUE(is_int(value));
+  EXPECT_EQ(atom_int(value), 2);
+
+  gc_release(env);
+}
+
+TEST(GCTest, SetcarOnOldBindingSurvivesMinor) {
+  struct source_file *source = source_file_str(
+      "(defmacro setcar! (place newval) `(set! ,place (cons ,newval (cdr ,place))))\n"
+      "(define x (cons 0 1))\n"
+      "(setcar! x 5)\n"
+      "x",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+  gc_retain(env);
+
+  eval(read_atom(source), env);
+  eval(read_atom(source), env);
+  gc_run();
+
+  eval(read_atom(source), env);
+  gc_run_minor();
+  churn();
+
+  struct atom *atom = eval(read_atom(source), env);
+  ASSERT_TRUE(is_cons(atom));
+  EXPECT_EQ(atom_int(car(atom)), 5);
+  EXPECT_EQ(atom_int(cdr(atom)), 1);
+
+  gc_release(env);
+
+  source_file_free(source);
+}
+
+TEST(GCTest, MaybeRunWaitsForBudget) {
+  gc_run();
+
+  // Nothing has been allocated, so no collection is due yet.
+  EXPECT_EQ(gc_maybe_run(), 0u);
+
+  for (int i = 0; i < 100000; ++i) {
+    new_boxed_int(i);
+  }
+
+  EXPECT_GT(gc_maybe_run(), 0u);
+}
+
+TEST(GCTest, ExternalMemoryCountsTowardsBudget) {
+  gc_run();
+
+  // The vector atom alone is far below the nursery budget, but its items aren't.
+  new_vector(100000, NULL);
+
+  EXPECT_GT(gc_maybe_run(), 0u);
+}
+
+TEST(GCTest, MaybeRunSweepsLazily) {
+  gc_run();
+
+  struct atom *list = atom_nil();
+  GC_PUSH_FRAME(frame, GC_ROOT(list));
+
+  for (int i = 0; i < 1000; ++i) {
+    list = new_cons(new_boxed_int(i), list);
+  }
+
+  // Garbage spread over many slabs, so that a full collection can't sweep them all at once.
+  size_t freed = 0;
+  while (!freed) {
+    for (int i = 0; i < 10000; ++i) {
+      new_boxed_int(i);
+    }
+    freed = gc_maybe_run();
+  }
+
+  // What the first sweep step left behind is swept as the cells are needed.
+  churn();
+  gc_run();
+
+  struct atom *atom = list;
+  for (int i = 999; i >= 0; --i) {
+    ASSERT_TRUE(is_cons(atom));
+    ASSERT_EQ(atom_int(car(atom)), i);
+    atom = cdr(atom);
+  }
+  EXPECT_TRUE(is_nil(atom));
+
+  GC_POP_FRAME(frame);
+}
+
+TEST(GCTest, SetParam) {
+  int previous = gc_set_param(GC_PARAM_PAUSE, 150);
+  EXPECT_GT(previous, 0);
+  EXPECT_EQ(gc_set_param(GC_PARAM_PAUSE, previous), 150);
+
+  EXPECT_EQ(gc_set_param(GC_PARAM_MINOR_MUL, 0), -1);
+  EXPECT_EQ(gc_set_param(GC_PARAM_COUNT, 100), -1);
+}
+
+TEST(GCTest, IncrementalCollectionKeepsLiveObjects) {
+  gc_run();
+  gc_set_incremental(1);
+  int max_pause = gc_set_param(GC_PARAM_MAX_PAUSE, 1);
+
+  // Enough live data to make a full collection due, so that marking takes several slices.
+  struct atom *live = atom_nil();
+  struct atom *other = atom_nil();
+  GC_PUSH_FRAME(frame, GC_ROOT(other), GC_ROOT(live));
+
+  for (int i = 0; i < 40000; ++i) {
+    live = new_cons(new_boxed_int(i), live);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    other = new_cons(new_boxed_int(-i), other);
+  }
+
+  struct gcpause_stats before;
+  gc_pause_stats(&before);
+
+  // Moving cells from other into live while marking is in progress only keeps them alive if the
+  // write barrier re-grays live, which may already have been traced.
+  size_t freed = 0;
+  int moved = 0;
+  while (!freed && is_cons(other)) {
+    struct atom *cell = other;
+    other = cdr(other);
+
+    atom_cons(cell)->cdr = cdr(live);
+    gc_write_barrier(cell);
+    atom_cons(live)->cdr = cell;
+    gc_write_barrier(live);
+    ++moved;
+
+    for (int i = 0; i < 1000; ++i) {
+      new_boxed_int(i);
+    }
+
+    freed = gc_maybe_run();
+  }
+
+  GC_POP_FRAME(frame);
+
+  struct gcpause_stats after;
+  gc_pause_stats(&after);
+
+  gc_set_incremental(0);
+  gc_set_param(GC_PARAM_MAX_PAUSE, max_pause);
+
+  EXPECT_GT(freed, 0u);
+  EXPECT_GT(after.count, before.count + 1);
+
+  churn();
+
+  // live now holds its original head, the moved cells in reverse order, then the rest.
+  EXPECT_EQ(atom_int(car(live)), 39999);
+  struct atom *atom = cdr(live);
+  for (int i = moved - 1; i >= 0; --i) {
+    ASSERT_TRUE(is_cons(atom));
+    EXPECT_EQ(atom_int(car(atom)), -(999 - i));
+    atom = cdr(atom);
+  }
+  for (int i = 39998; i >= 0; --i) {
+    ASSERT_TRUE(is_cons(atom));
+    EXPECT_EQ(atom_int(car(atom)), i);
+    atom = cdr(atom);
+  }
+  EXPECT_TRUE(is_nil(atom));
+}
+
+TEST(GCTest, RunAbandonsIncrementalMarking) {
+  gc_run();
+  gc_set_incremental(1);
+  int max_pause = gc_set_param(GC_PARAM_MAX_PAUSE, 1);
+
+  struct atom *live = atom_nil();
+  struct atom *dropped = atom_nil();
+  GC_PUSH_FRAME(frame, GC_ROOT(dropped), GC_ROOT(live));
+
+  for (int i = 0; i < 40000; ++i) {
+    live = new_cons(new_boxed_int(i), live);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    dropped = new_cons(new_boxed_int(i), dropped);
+  }
+
+  while (!gc_is_marking()) {
+    for (int i = 0; i < 1000; ++i) {
+      new_boxed_int(i);
+    }
+    gc_maybe_run();
+  }
+
+  // dropped was marked as a root when marking started, but a full collection has to free it.
+  dropped = atom_nil();
+  gc_run();
+
+  EXPECT_FALSE(gc_is_marking());
+  EXPECT_EQ(gc_run(), 0u);
+
+  GC_POP_FRAME(frame);
+
+  gc_set_incremental(0);
+  gc_set_param(GC_PARAM_MAX_PAUSE, max_pause);
+}
+
+TEST(GCTest, MarksVeryLongList) {
+  gc_run();
+
+  struct atom *one = new_boxed_int(1);
+  struct atom *list = atom_nil();
+  GC_PUSH_FRAME(frame, GC_ROOT(list));
+
+  for (int i = 0; i < 1000000; ++i) {
+    list = new_cons(one, list);
+  }
+
+  EXPECT_EQ(gc_run(), 0u);
+  EXPECT_EQ(gc_run_minor(), 0u);
+
+  GC_POP_FRAME(frame);
+
+  EXPECT_GE(gc_run(), 1000000 * sizeof(struct cons));
+}
+
+TEST(GCTest, MarkStackOverflowIsRecovered) {
+  gc_run();
+
+  // Walking the spine queues every element, which is more than the mark stack holds.
+  struct atom *list = atom_nil();
+  GC_PUSH_FRAME(frame, GC_ROOT(list));
+
+  for (int i = 0; i < 200000; ++i) {
+    list = new_cons(new_cons(new_boxed_int(i), atom_nil()), list);
+  }
+
+  EXPECT_EQ(gc_run_minor(), 0u);
+  EXPECT_EQ(gc_run(), 0u);
+  churn();
+
+  struct atom *atom = list;
+  for (int i = 199999; i >= 0; --i) {
+    ASSERT_TRUE(is_cons(atom));
+    ASSERT_EQ(atom_int(car(car(atom))), i);
+    atom = cdr(atom);
+  }
+  EXPECT_TRUE(is_nil(atom));
+
+  GC_POP_FRAME(frame);
+}
+
+TEST(GCTest, ParallelMarkKeepsLiveObjects) {
+  gc_run();
+  ASSERT_EQ(gc_set_threads(4), 1);
+
+  // A list of lists gives the markers plenty to steal, and is too wide for their deques.
+  struct atom *list = atom_nil();
+  struct environment *env = create_environment(NULL);
+  GC_PUSH_FRAME(frame, GC_ROOT(list), GC_ROOT(env));
+
+  for (int i = 0; i < 200000; ++i) {
+    list = new_cons(new_cons(new_boxed_int(i), atom_nil()), list);
+  }
+  env_bind(env, intern("list", 0), list);
+
+  EXPECT_EQ(gc_run(), 0u);
+  churn();
+  gc_run();
+
+  struct atom *atom = env_lookup(env, intern("list", 0));
+  for (int i = 199999; i >= 0; --i) {
+    ASSERT_TRUE(is_cons(atom));
+    ASSERT_EQ(atom_int(car(car(atom))), i);
+    atom = cdr(atom);
+  }
+  EXPECT_TRUE(is_nil(atom));
+
+  GC_POP_FRAME(frame);
+
+  EXPECT_GE(gc_run(), 200000 * (2 * sizeof(struct cons) + sizeof(struct atom)));
+  EXPECT_EQ(gc_set_threads(1), 4);
+  EXPECT_EQ(gc_set_threads(0), -1);
+}
+
+TEST(GCTest, CompactMovesSparseObjects) {
+  gc_run();
+
+  // Keep every tenth element of a long list, leaving its slabs sparse.
+  struct atom *kept = atom_nil();
+  struct atom *list = atom_nil();
+  struct environment *env = create_environment(NULL);
+  GC_PUSH_FRAME(frame, GC_ROOT(kept), GC_ROOT(list), GC_ROOT(env));
+
+  for (int i = 0; i < 100000; ++i) {
+    list = new_cons(new_boxed_int(i), list);
+  }
+  for (struct atom *atom = list; is_cons(atom); atom = cdr(atom)) {
+    if (atom_int(car(atom)) % 10 == 0) {
+      kept = new_cons(car(atom), kept);
+    }
+  }
+  list = atom_nil();
+
+  struct atom *pinned = new_boxed_int(-1);
+  gc_retain(pinned);
+  env_bind(env, intern("gc-test-kept", 0), kept);
+  std::vector<struct atom *> before;
+  for (struct atom *atom = kept; is_cons(atom); atom = cdr(atom)) {
+    before.push_back(car(atom));
+  }
+
+  EXPECT_GT(gc_compact(), 0u);
+
+  // Most kept integers were moved out of the list's old slabs, the cells pointing at them updated.
+  size_t moved = 0;
+  size_t index = 0;
+  for (struct atom *atom = kept; is_cons(atom); atom = cdr(atom)) {
+    moved += car(atom) != before[index++];
+  }
+  EXPECT_GT(moved, before.size() / 2);
+  EXPECT_EQ(env_lookup(env, intern("gc-test-kept", 0)), kept);
+  EXPECT_EQ(atom_int(pinned), -1);
+  churn();
+
+  struct atom *atom = kept;
+  for (int i = 0; i < 100000; i += 10) {
+    ASSERT_TRUE(is_cons(atom));
+    ASSERT_EQ(atom_int(car(atom)), i);
+    atom = cdr(atom);
+  }
+  EXPECT_TRUE(is_nil(atom));
+
+  GC_POP_FRAME(frame);
+  gc_release(pinned);
+}
+
+TEST(GCTest, CompactMovesAtomsInternedBetween) {
+  gc_run();
+
+  // Intern symbols in between the integers, as reading a script does, then keep every tenth
+  // integer.
+  struct atom *kept = atom_nil();
+  struct atom *list = atom_nil();
+  GC_PUSH_FRAME(frame, GC_ROOT(kept), GC_ROOT(list));
+
+  std::vector<struct atom *> symbols;
+  for (int i = 0; i < 100000; ++i) {
+    list = new_cons(new_boxed_int(i), list);
+    if (i % 100 == 0) {
+      symbols.push_back(intern(("gc-test-interned-" + std::to_string(i)).c_str(), i % 200 == 0));
+    }
+  }
+  for (struct atom *atom = list; is_cons(atom); atom = cdr(atom)) {
+    if (atom_int(car(atom)) % 10 == 0) {
+      kept = new_cons(car(atom), kept);
+    }
+  }
+  list = atom_nil();
+
+  std::vector<struct atom *> before;
+  for (struct atom *atom = kept; is_cons(atom); atom = cdr(atom)) {
+    before.push_back(car(atom));
+  }
+
+  gc_compact();
+
+  // The symbols don't pin the integers' slabs, and stay where the intern tables point.
+  size_t moved = 0;
+  size_t index = 0;
+  for (struct atom *atom = kept; is_cons(atom); atom = cdr(atom)) {
+    moved += car(atom) != before[index++];
+  }
+  EXPECT_GT(moved, before.size() / 2);
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    std::string name = "gc-test-interned-" + std::to_string(i * 100);
+    EXPECT_EQ(intern(name.c_str(), i % 2 == 0), symbols[i]);
+    EXPECT_STREQ(symbols[i]->value.string.ptr, name.c_str());
+  }
+
+  GC_POP_FRAME(frame);
+}
+
+TEST(GCTest, CompactKeepsInlineBindings) {
+  gc_run();
+
+  struct atom *kept = atom_nil();
+  struct atom *list = atom_nil();
+  GC_PUSH_FRAME(frame, GC_ROOT(kept), GC_ROOT(list));
+
+  // closures over frames that hold their bindings inline, every tenth of which is kept
+  struct source_file *source = source_file_str("(lambda (x) (lambda () (+ x 0)))", 0);
+  struct atom *make = eval(read_atom(source), create_default_environment());
+  list = new_cons(make, list);
+  for (int i = 0; i < 20000; ++i) {
+    list = new_cons(apply(make, new_cons(new_int(i), atom_nil()), NULL), list);
+  }
+  int i = 19999;
+  for (struct atom *atom = list; i >= 0; atom = cdr(atom), --i) {
+    if (i % 10 == 0) {
+      kept = new_cons(car(atom), kept);
+    }
+  }
+  list = atom_nil();
+
+  gc_compact();
+  churn();
+
+  // Moved environments look their bindings up in their own inline array.
+  struct atom *atom = kept;
+  for (i = 0; i < 20000; i += 10) {
+    ASSERT_TRUE(is_lambda(car(atom)));
+    ASSERT_EQ(atom_int(apply(car(atom), atom_nil(), NULL)), i);
+    atom = cdr(atom);
+  }
+
+  GC_POP_FRAME(frame);
+  source_file_free(source);
+}
+
+TEST(GCTest, CompactKeepsInlineStrings) {
+  gc_run();
+
+  struct atom *kept = atom_nil();
+  struct atom *list = atom_nil();
+  GC_PUSH_FRAME(frame, GC_ROOT(kept), GC_ROOT(list));
+
+  char buf[32];
+  for (int i = 0; i < 20000; ++i) {
+    snprintf(buf, sizeof(buf), "s%d", i);
+    list = new_cons(new_string(ATOM_TYPE_STRING, buf, strlen(buf)), list);
+  }
+  for (struct atom *atom = list; is_cons(atom); atom = cdr(atom)) {
+    if (atoi(car(atom)->value.string.ptr + 1) % 10 == 0) {
+      kept = new_cons(car(atom), kept);
+    }
+  }
+  list = atom_nil();
+
+  gc_compact();
+  churn();
+
+  // Moved short strings point at their own inline buffer, not the one they were copied from.
+  struct atom *atom = kept;
+  for (int i = 0; i < 20000; i += 10) {
+    ASSERT_TRUE(is_string(car(atom)));
+    struct atom *string = car(atom);
+    EXPECT_EQ(string->value.string.ptr, string->value.string.storage.small);
+    snprintf(buf, sizeof(buf), "s%d", i);
+    ASSERT_STREQ(string->value.string.ptr, buf);
+    atom = cdr(atom);
+  }
+
+  GC_POP_FRAME(frame);
+}
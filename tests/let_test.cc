@@ -15,7 +15,7 @@ TEST(LetTest, LetBinding) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 6);
+  EXPECT_EQ(atom_int(atom), 6);
 
   source_file_free(source);
 }
@@ -28,7 +28,7 @@ TEST(LetTest, ShadowingVariables) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 3);
+  EXPECT_EQ(atom_int(atom), 3);
 
   source_file_free(source);
 }
@@ -41,7 +41,7 @@ TEST(LetTest, BindingReferences) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 6);
+  EXPECT_EQ(atom_int(atom), 6);
 
   source_file_free(source);
 }
@@ -54,7 +54,7 @@ TEST(LetTest, NestedBindingReferences) {
 
   struct atom *atom = eval(read_atom(source), env);
   EXPECT_TRUE(is_int(atom));
-  EXPECT_EQ(atom->value.ivalue, 6);
+  EXPECT_EQ(atom_int(atom), 6);
 
   source_file_free(source);
 }
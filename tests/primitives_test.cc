@@ -7,6 +7,8 @@
 #include <read.h>
 #include <source.h>
 
+#include <string>
+
 TEST(PrimitivesTest, CarMustHaveOneArgument) {
   struct source_file *source = source_file_str("(car)", 0);
   ASSERT_TRUE(source != NULL);
@@ -213,3 +215,33 @@ TEST(PrimitivesTest, EqualityCons) {
 
   source_file_free(source);
 }
+
+TEST(PrimitivesTest, Substring) {
+  struct source_file *source = source_file_str(
+      "(substring \"a string long enough to share its buffer\" 2 29)"
+      "(substring \"hello\" 1)"
+      "(substring \"hello\" 3 9)"
+      "(read (substring \"(1 2 3) and then some trailing text\" 0 7))",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  struct atom *atom = eval(read_atom(source), env);
+  ASSERT_TRUE(is_string(atom));
+  EXPECT_EQ(std::string(atom->value.string.ptr, atom->value.string.len),
+            "string long enough to share");
+
+  atom = eval(read_atom(source), env);
+  ASSERT_TRUE(is_string(atom));
+  EXPECT_STREQ(atom->value.string.ptr, "ello");
+
+  EXPECT_TRUE(is_error(eval(read_atom(source), env)));
+
+  atom = eval(read_atom(source), env);
+  ASSERT_TRUE(is_cons(atom));
+  EXPECT_EQ(atom_int(car(cdr(cdr(atom)))), 3);
+  EXPECT_TRUE(is_nil(cdr(cdr(cdr(atom)))));
+
+  source_file_free(source);
+}
@@ -4,6 +4,7 @@
 #include <gc.h>
 #include <gtest/gtest.h>
 #include <log.h>
+#include <print.h>
 #include <read.h>
 #include <source.h>
 
@@ -134,3 +135,23 @@ TEST(PrintTest, TooManyArguments) {
 
   source_file_free(source);
 }
+
+TEST(PrintTest, LongListIsTruncated) {
+  union atom_value value;
+  value.ivalue = 12345;
+  struct atom *item = new_atom(ATOM_TYPE_INT, value);
+
+  struct atom *list = atom_nil();
+  for (int i = 0; i < 10000; ++i) {
+    list = new_cons(item, list);
+  }
+
+  char buffer[64];
+  memset(buffer, 'x', sizeof(buffer));
+
+  int length = print_str(buffer, 32, list, 0);
+  EXPECT_GE(length, 32);
+  EXPECT_EQ(strlen(buffer), 31u);
+  EXPECT_EQ(strncmp(buffer, "(12345 12345 12345", 18), 0);
+  EXPECT_EQ(buffer[32], 'x');
+}
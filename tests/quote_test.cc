@@ -48,7 +48,7 @@ TEST(QuoteTests, BasicUnquote) {
   value = car(atom);
 
   EXPECT_TRUE(is_int(value));
-  EXPECT_EQ(value->value.ivalue, 5);
+  EXPECT_EQ(atom_int(value), 5);
 
   source_file_free(source);
 }
@@ -0,0 +1,144 @@
+#include <atom.h>
+#include <env.h>
+#include <eval.h>
+#include <gc.h>
+#include <gtest/gtest.h>
+#include <log.h>
+#include <read.h>
+#include <source.h>
+
+#include <string>
+
+TEST(ResolveTest, ResolvesParametersToSlots) {
+  struct source_file *source = source_file_str("(lambda (x y) (lambda (z) (+ x z y '(x))))", 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  struct atom *outer = eval(read_atom(source), env);
+  ASSERT_TRUE(is_lambda(outer));
+
+  // the inner lambda form, with its body resolved along with the outer one
+  struct atom *inner = outer->value.lambda.body;
+  EXPECT_TRUE(is_special(car(inner)));
+
+  struct atom *body = car(cdr(cdr(inner)));
+  EXPECT_TRUE(is_symbol(car(body)));  // + is a global
+
+  struct atom *x = car(cdr(body));
+  ASSERT_TRUE(is_local(x));
+  EXPECT_EQ(x->value.local.depth, 1u);
+  EXPECT_EQ(x->value.local.slot, 0u);
+
+  struct atom *z = car(cdr(cdr(body)));
+  ASSERT_TRUE(is_local(z));
+  EXPECT_EQ(z->value.local.depth, 0u);
+  EXPECT_EQ(z->value.local.slot, 0u);
+
+  struct atom *y = car(cdr(cdr(cdr(body))));
+  ASSERT_TRUE(is_local(y));
+  EXPECT_EQ(y->value.local.depth, 1u);
+  EXPECT_EQ(y->value.local.slot, 1u);
+
+  // quoted data is left alone
+  struct atom *quoted = car(cdr(cdr(cdr(cdr(body)))));
+  EXPECT_TRUE(is_symbol(car(car(cdr(quoted)))));
+
+  source_file_free(source);
+}
+
+TEST(ResolveTest, ClosuresAndShadowing) {
+  struct source_file *source = source_file_str(
+      "(define make-adder (lambda (x) (lambda (y) (+ x y))))"
+      "((make-adder 3) 4)"
+      "(let ((x 1)) (let ((x 2)) (let ((y x)) y)))"
+      "(defun f (x) ((lambda (y) (begin (defun x () (+ 100 0)) (+ (x) y))) 1))"
+      "(f 5)"
+      "(defun g (x) (let ((x (* x 2))) (let ((y x)) (begin (set! x 0) (+ x y)))))"
+      "(g 21)",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  eval(read_atom(source), env);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 7);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 2);
+
+  // the defun in the inner frame shadows the outer parameter the reference was resolved to
+  eval(read_atom(source), env);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 101);
+
+  eval(read_atom(source), env);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 42);
+
+  source_file_free(source);
+}
+
+TEST(ResolveTest, MacrosAndQuasiquote) {
+  struct source_file *source = source_file_str(
+      "(defmacro swap! (a b) `(let ((tmp ,a)) (begin (set! ,a ,b) (set! ,b tmp))))"
+      "(defun f (x y) (begin (swap! x y) (cons x y)))"
+      "(f 1 2)"
+      "(defun g (x) `(x ,x `(,x ,,x)))"
+      "(g 3)",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  eval(read_atom(source), env);
+  eval(read_atom(source), env);
+
+  struct atom *atom = eval(read_atom(source), env);
+  ASSERT_TRUE(is_cons(atom));
+  EXPECT_EQ(atom_int(car(atom)), 2);
+  EXPECT_EQ(atom_int(cdr(atom)), 1);
+
+  eval(read_atom(source), env);
+  atom = eval(read_atom(source), env);
+  ASSERT_TRUE(is_cons(atom));
+  EXPECT_TRUE(is_symbol(car(atom)));
+  EXPECT_EQ(atom_int(car(cdr(atom))), 3);
+
+  // (quasiquote ((unquote x) (unquote 3))): the nested template is only resolved one level down
+  struct atom *nested = car(cdr(car(cdr(cdr(atom)))));
+  EXPECT_TRUE(is_symbol(car(cdr(car(nested)))));
+  EXPECT_EQ(atom_int(car(cdr(car(cdr(nested))))), 3);
+
+  source_file_free(source);
+}
+
+TEST(ResolveTest, LongLists) {
+  // far more elements than the C stack could take frames for, were lists resolved recursively
+  std::string ones;
+  for (int i = 0; i < 1000000; ++i) {
+    ones += "1 ";
+  }
+
+  std::string code = "(lambda (x) (begin " + ones + "x))\n(lambda (x) `(" + ones + ",x 1))";
+  struct source_file *source = source_file_str(code.c_str(), 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  struct atom *fn = eval(read_atom(source), env);
+  ASSERT_TRUE(is_lambda(fn));
+  struct atom *last = fn->value.lambda.body;
+  while (is_cons(cdr(last))) {
+    last = cdr(last);
+  }
+  EXPECT_TRUE(is_local(car(last)));
+
+  fn = eval(read_atom(source), env);
+  ASSERT_TRUE(is_lambda(fn));
+  struct atom *element = car(cdr(fn->value.lambda.body));
+  for (int i = 0; i < 1000000; ++i) {
+    ASSERT_TRUE(is_cons(element));
+    element = cdr(element);
+  }
+  EXPECT_TRUE(is_local(car(cdr(car(element)))));
+  EXPECT_EQ(atom_int(car(cdr(element))), 1);
+
+  source_file_free(source);
+}
@@ -0,0 +1,139 @@
+#include <atom.h>
+#include <env.h>
+#include <eval.h>
+#include <gc.h>
+#include <gtest/gtest.h>
+#include <intern.h>
+#include <log.h>
+#include <read.h>
+#include <source.h>
+#include <string.h>
+#include <table.h>
+
+TEST(TableTest, PutGetRemove) {
+  struct atom *table = new_table();
+  EXPECT_EQ(table_get(table, new_int(1)), (struct atom *)NULL);
+
+  for (int i = 0; i < 1000; ++i) {
+    table_put(table, new_int(i), new_int(i * 2));
+  }
+  EXPECT_EQ(table->value.table.count, 1000u);
+
+  for (int i = 0; i < 1000; i += 2) {
+    EXPECT_TRUE(table_remove(table, new_int(i)));
+  }
+  EXPECT_FALSE(table_remove(table, new_int(0)));
+  EXPECT_EQ(table->value.table.count, 500u);
+
+  for (int i = 0; i < 1000; ++i) {
+    struct atom *value = table_get(table, new_int(i));
+    if (i % 2) {
+      ASSERT_TRUE(value != NULL);
+      EXPECT_EQ(atom_int(value), i * 2);
+    } else {
+      EXPECT_EQ(value, (struct atom *)NULL);
+    }
+  }
+
+  // Replacing a value doesn't add an entry.
+  table_put(table, new_int(1), atom_nil());
+  EXPECT_TRUE(is_nil(table_get(table, new_int(1))));
+  EXPECT_EQ(table->value.table.count, 500u);
+}
+
+TEST(TableTest, EntriesCountTowardsBudget) {
+  gc_run();
+
+  // Small integers aren't heap objects, so the entries are nearly all this allocates.
+  struct atom *table = new_table();
+  for (int i = 0; i < 4096; ++i) {
+    table_put(table, new_int(i), new_int(i));
+  }
+
+  EXPECT_GT(gc_maybe_run(), 0u);
+}
+
+TEST(TableTest, KeysCompareByValue) {
+  struct atom *table = new_table();
+
+  const char *name = "a key longer than an inline string";
+  table_put(table, new_string(ATOM_TYPE_STRING, name, strlen(name)), new_int(1));
+  table_put(table, intern("key", 0), new_int(2));
+  table_put(table, intern(":key", 1), new_int(3));
+  table_put(table, new_int(INT64_MAX), new_int(4));
+
+  EXPECT_EQ(atom_int(table_get(table, new_string(ATOM_TYPE_STRING, name, strlen(name)))), 1);
+  EXPECT_EQ(atom_int(table_get(table, intern("key", 0))), 2);
+  EXPECT_EQ(atom_int(table_get(table, intern(":key", 1))), 3);
+  EXPECT_EQ(atom_int(table_get(table, new_int(INT64_MAX))), 4);
+  EXPECT_EQ(table_get(table, new_string(ATOM_TYPE_STRING, "key", 3)), (struct atom *)NULL);
+
+  EXPECT_FALSE(table_key_valid(new_float(1.0)));
+  EXPECT_FALSE(table_key_valid(atom_nil()));
+}
+
+TEST(TableTest, Primitives) {
+  struct source_file *source = source_file_str(
+      "(define config (make-table))"
+      "(table-put! config :port 8080)"
+      "(table-put! config \"host\" \"localhost\")"
+      "(table-get config :port)"
+      "(table-get config :missing 0)"
+      "(table-remove! config :port)"
+      "(table-count config)"
+      "(table-entries config)"
+      "(table-get config 1.5)",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  eval(read_atom(source), env);
+  eval(read_atom(source), env);
+  eval(read_atom(source), env);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 8080);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 0);
+  EXPECT_TRUE(is_true(eval(read_atom(source), env)));
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 1);
+
+  struct atom *entries = eval(read_atom(source), env);
+  ASSERT_TRUE(is_cons(entries));
+  EXPECT_STREQ(car(car(entries))->value.string.ptr, "host");
+  EXPECT_STREQ(cdr(car(entries))->value.string.ptr, "localhost");
+  EXPECT_TRUE(is_nil(cdr(entries)));
+
+  EXPECT_TRUE(is_error(eval(read_atom(source), env)));
+
+  source_file_free(source);
+}
+
+TEST(TableTest, EntriesSurviveCompaction) {
+  gc_run();
+
+  struct atom *table = new_table();
+  struct atom *garbage = atom_nil();
+  GC_PUSH_FRAME(frame, GC_ROOT(table), GC_ROOT(garbage));
+
+  // Interleave the entries with garbage so that compaction moves them.
+  char buf[32];
+  for (int i = 0; i < 5000; ++i) {
+    snprintf(buf, sizeof(buf), "key %d", i);
+    table_put(table, new_string(ATOM_TYPE_STRING, buf, strlen(buf)), new_cons(new_int(i), NULL));
+    for (int j = 0; j < 8; ++j) {
+      garbage = new_cons(new_string(ATOM_TYPE_STRING, buf, strlen(buf)), garbage);
+    }
+  }
+  garbage = atom_nil();
+
+  gc_compact();
+  gc_run_minor();
+
+  for (int i = 0; i < 5000; ++i) {
+    snprintf(buf, sizeof(buf), "key %d", i);
+    struct atom *value = table_get(table, new_string(ATOM_TYPE_STRING, buf, strlen(buf)));
+    ASSERT_TRUE(value != NULL);
+    EXPECT_EQ(atom_int(car(value)), i);
+  }
+
+  GC_POP_FRAME(frame);
+}
@@ -1,11 +1,13 @@
 #include <atom.h>
 #include <clog.h>
+#include <env.h>
 #include <gc.h>
 #include <gtest/gtest.h>
 #include <intern.h>
 #include <log.h>
 #include <read.h>
 #include <source.h>
+#include <special.h>
 
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
@@ -17,6 +19,8 @@ int main(int argc, char **argv) {
 
   int rc = RUN_ALL_TESTS();
 
+  cleanup_special_forms();
+  env_reset_shadows();
   cleanup_intern_tables();
 
   gc_run();
@@ -0,0 +1,97 @@
+#include <atom.h>
+#include <env.h>
+#include <eval.h>
+#include <gc.h>
+#include <gtest/gtest.h>
+#include <log.h>
+#include <print.h>
+#include <read.h>
+#include <source.h>
+
+TEST(VectorTest, ReadAndPrint) {
+  struct source_file *source = source_file_str("[1 \"two\" (3 4) [5]]", 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  struct atom *atom = eval(read_atom(source), env);
+  ASSERT_TRUE(is_vector(atom));
+  EXPECT_EQ(atom->value.vector.len, 4u);
+  EXPECT_EQ(atom_int(atom->value.vector.items[0]), 1);
+  EXPECT_TRUE(is_vector(atom->value.vector.items[3]));
+
+  char buf[64];
+  print_str(buf, sizeof(buf), atom, 1);
+  EXPECT_STREQ(buf, "[1 \"two\" (3 4) [5]]");
+
+  source_file_free(source);
+}
+
+TEST(VectorTest, UnterminatedVector) {
+  struct source_file *source = source_file_str("[1 2", 0);
+  ASSERT_TRUE(source != NULL);
+
+  EXPECT_TRUE(is_error(read_atom(source)));
+
+  source_file_free(source);
+}
+
+TEST(VectorTest, Primitives) {
+  struct source_file *source = source_file_str(
+      "(define v (make-vector 3 0))"
+      "(vector-set! v 1 42)"
+      "(vector-push! v 7)"
+      "(vector-length v)"
+      "(+ (vector-ref v 1) (vector-ref v 3))"
+      "(vector-ref v 4)"
+      "(vector-length (vector 1 2))",
+      0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  eval(read_atom(source), env);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 42);
+  EXPECT_TRUE(is_vector(eval(read_atom(source), env)));
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 4);
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 49);
+  EXPECT_TRUE(is_error(eval(read_atom(source), env)));
+  EXPECT_EQ(atom_int(eval(read_atom(source), env)), 2);
+
+  source_file_free(source);
+}
+
+TEST(VectorTest, MakeVectorTooLarge) {
+  // len * sizeof(struct atom *) wraps around to 8 for this length.
+  struct source_file *source = source_file_str("(make-vector 2305843009213693953 0)", 0);
+  ASSERT_TRUE(source != NULL);
+
+  struct environment *env = create_default_environment();
+
+  EXPECT_TRUE(is_error(eval(read_atom(source), env)));
+
+  source_file_free(source);
+}
+
+TEST(VectorTest, ElementsSurviveCollections) {
+  gc_run();
+
+  struct atom *vector = new_vector(0, NULL);
+  GC_PUSH_FRAME(frame, GC_ROOT(vector));
+
+  // The vector is old after this, and pushing young elements must keep them alive in minor
+  // collections.
+  gc_run();
+  for (int i = 0; i < 100; ++i) {
+    vector_push(vector, new_cons(new_int(i), atom_nil()));
+  }
+  gc_run_minor();
+  gc_run();
+
+  GC_POP_FRAME(frame);
+
+  ASSERT_EQ(vector->value.vector.len, 100u);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(atom_int(car(vector->value.vector.items[i])), i);
+  }
+}